@@ -0,0 +1,57 @@
+//cross-thread pushes under contention, 1 to 64 producer threads feeding one runnable.
+//run from the ts directory: make bench, or make build/bench/mpsc && ./build/bench/mpsc [tasks]
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <ts/asyn.h>
+
+_TS_NAMESPACE_USING
+
+struct counter : public life {
+    std::atomic<long>   done;
+
+    counter(void) : done(0) {}
+    void hit(void) {
+        done.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+static void produce(std::shared_ptr<runnable> target, counter* c, int count) {
+    for (int i = 0; i < count; i++) {
+        ts::asyn2(target, c, &counter::hit);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int total = argc > 1 ? atoi(argv[1]) : 1000000;
+    runnable* consumer = new runnable("mpsc");
+    consumer->start();
+    std::shared_ptr<runnable> target = std::static_pointer_cast<runnable>(consumer->clone());
+    counter* c = new counter();
+
+    static const int producers[] = {1, 2, 4, 8, 16, 32, 64};
+    for (size_t k = 0; k < sizeof(producers) / sizeof(producers[0]); k++) {
+        int n = producers[k], each = total / n;
+        long expect = (long)each * n;
+        c->done = 0;
+        int64_t begin = getUptimeInMicroseconds();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < n; i++) {
+            threads.push_back(std::thread(produce, target, c, each));
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        int64_t pushed = getUptimeInMicroseconds();
+        while (c->done.load(std::memory_order_relaxed) < expect) {
+            std::this_thread::yield();
+        }
+        int64_t drained = getUptimeInMicroseconds();
+        printf("producers=%2d push %6.2f Mops/s, end-to-end %6.2f Mops/s\n", n, expect / (double)(pushed - begin), expect / (double)(drained - begin));
+    }
+    fflush(stdout);
+    _exit(0);
+}
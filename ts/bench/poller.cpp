@@ -0,0 +1,96 @@
+//loopback echo round trips through net::server, one runnable per poller backend.
+//run from the ts directory: make bench, or make build/bench/poller && ./build/bench/poller [connections] [rounds]
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <vector>
+#include <ts/net.h>
+#include <ts/log.h>
+
+_TS_NAMESPACE_USING
+
+struct echo : public net::server {
+    std::atomic<int>    closed;
+
+    echo(runnable const& host) : net::server(host, 1024), closed(0) {}
+    void onConnectionComming(std::shared_ptr<net::connection>&& conn) {}
+    void onConnectionRecv(std::shared_ptr<net::connection>&& conn, const net::address_t& from, std::shared_ptr<std::string>& packet) {
+        conn->send(packet);
+    }
+    void onConnectionClose(std::shared_ptr<net::connection>& conn) {
+        closed++;
+    }
+    void listen(uint16_t port) {
+        bind(net::address_t("127.0.0.1", port), false);
+    }
+};
+
+static double run(runnable::poller_t type, uint16_t port, int connections, int rounds) {
+    runnable* host = new runnable("bench", type);
+    host->start();
+    echo* server = new echo(*host);
+    ts::asyn2(std::static_pointer_cast<runnable>(host->clone()), server, &echo::listen, port);
+    usleep(100000);
+
+    std::vector<int> fds;
+    for (int i = 0; i < connections; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &sa.sin_addr);
+        if (connect(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+            log_error("connect failed, err=%s", strerror(errno));
+            return -1;
+        }
+        fds.push_back(fd);
+    }
+
+    static const char ping[] = "ping-pong-ping-pong";
+    char buf[64];
+    int64_t begin = getUptimeInMicroseconds();
+    for (int i = 0; i < rounds; i++) {
+        int fd = fds[i % connections];
+        if (send(fd, ping, sizeof(ping) - 1, 0) != sizeof(ping) - 1) {
+            return -1;
+        }
+        for (ssize_t got = 0, rx = 0; got < (ssize_t)sizeof(ping) - 1; got += rx) {
+            if ((rx = recv(fd, buf, sizeof(buf), 0)) <= 0) {
+                return -1;
+            }
+        }
+    }
+    int64_t elapsed = getUptimeInMicroseconds() - begin;
+
+    for (size_t i = 0; i < fds.size(); i++) {
+        close(fds[i]);
+    }
+    for (int i = 0; i < 100 && server->closed < connections; i++) {
+        usleep(10000);
+    }
+    return elapsed / (double)rounds;
+}
+
+int main(int argc, char* argv[]) {
+    ts::log::hook([](ts::log::level lv, int, const char*, const char*, int, const char*, int) {}); /*peers closing are logged as errors*/
+    int connections = argc > 1 ? atoi(argv[1]) : 4;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20000;
+    static const struct {
+        const char*         name;
+        runnable::poller_t  type;
+    } backends[] = {{"select", runnable::POLLER_SELECT}, {"epoll", runnable::POLLER_EPOLL}};
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        double us = run(backends[i].type, (uint16_t)(17700 + i), connections, rounds);
+        printf("%-8s connections=%d rounds=%d %.2f us/round trip\n", backends[i].name, connections, rounds, us);
+    }
+    fflush(stdout);
+    _exit(0); /*runnables and servers are left to the process*/
+}
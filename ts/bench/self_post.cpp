@@ -0,0 +1,65 @@
+//tasks posted by a runnable to itself, the same-thread path of ts::asyn and runnable::push.
+//run from the ts directory: make bench, or make build/bench/self_post && ./build/bench/self_post [tasks]
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <ts/asyn.h>
+
+_TS_NAMESPACE_USING
+
+struct poster : public runnable {
+    int64_t     total;
+    int64_t     count;
+    int64_t     begin;
+    std::atomic<bool>   done;
+
+    explicit poster(int64_t n) : runnable("selfPost"), total(n), count(0), begin(0), done(false) {}
+
+    //one chain through ts::asyn, the member-binding way
+    void bound(int64_t k) {
+        if (count == 0) {
+            begin = getUptimeInMicroseconds();
+        }
+        if (++count == total) {
+            report("asyn");
+            count = 0;
+            runnable::push(task([this]() {
+                lambda();
+            }));
+            return;
+        }
+        ts::asyn(this, &poster::bound, k + 1);
+    }
+    //another one through runnable::push with a lambda task
+    void lambda(void) {
+        if (count == 0) {
+            begin = getUptimeInMicroseconds();
+        }
+        if (++count == total) {
+            report("push");
+            done = true;
+            return;
+        }
+        runnable::push(task([this]() {
+            lambda();
+        }));
+    }
+    void report(const char* name) {
+        int64_t elapsed = getUptimeInMicroseconds() - begin;
+        runnable::stats_t st = stats();
+        printf("%-5s %lld tasks in %lld ms, %.2f Mtasks/s, nodes allocated=%llu recycled=%llu\n", name, (long long)total, (long long)elapsed / 1000, total / (double)elapsed,
+               (unsigned long long)st.allocated, (unsigned long long)st.recycled);
+    }
+};
+
+int main(int argc, char* argv[]) {
+    poster* p = new poster(argc > 1 ? atoll(argv[1]) : 2000000);
+    p->start();
+    ts::asyn2(std::static_pointer_cast<runnable>(p->clone()), p, &poster::bound, (int64_t)0);
+    while (!p->done) {
+        usleep(1000);
+    }
+    fflush(stdout);
+    _exit(0);
+}
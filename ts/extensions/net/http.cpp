@@ -121,8 +121,9 @@ namespace net { namespace http {
     }
     
     void server::commit(std::shared_ptr<net::connection> pconn, std::shared_ptr<std::string> response) {
-        if (runnable::current() != &_host) {
-            ts::asyn2(std::dynamic_pointer_cast<ts::runnable>(this->clone()), this, &server::commit, pconn, response);
+        runnable* target = pconn->host() ? pconn->host() : const_cast<runnable*>(&_host); /*a worker if setWorkers is used*/
+        if (runnable::current() != target) {
+            ts::urgent2(std::dynamic_pointer_cast<ts::runnable>(target->clone()), this, &server::commit, std::move(pconn), std::move(response));
             return;
         }
         net::connection& conn = *pconn.get();
@@ -21,10 +21,14 @@
 #pragma once
 
 #include <memory>
+#include <new>
+#include <cstddef>
 #include <type_traits>
 #include <tuple>
 #include <functional>
 #include <thread>
+#include <typeinfo>
+#include <vector>
 #include <ts/types.h>
 
 _TS_NAMESPACE_BEGIN
@@ -48,6 +52,100 @@ private:
     mutable std::shared_ptr<life> _this;
 };
 
+//move-only callable, small ones live inline so posting them allocates nothing
+struct task {
+    static constexpr size_t inline_size = 64;
+    
+    task(void) : _ops(nullptr), _owner(nullptr) {}
+    
+    //owner is what cancelOwner matches against
+    template <class F, class D = typename std::decay<F>::type, class = typename std::enable_if<!std::is_same<D, task>::value>::type, class = decltype(std::declval<D&>()())>
+    task(F&& fn, void* owner = nullptr) : _ops(ops_t<D>::get()), _owner(owner) {
+        ops_t<D>::construct(_storage, std::forward<F>(fn));
+    }
+    task(task&& b) : _ops(b._ops), _owner(b._owner) {
+        if (_ops) {
+            _ops->move(_storage, b._storage);
+            b._ops = nullptr;
+        }
+    }
+    task& operator = (task&& b) {
+        if (this != &b) {
+            reset();
+            _ops = b._ops;
+            _owner = b._owner;
+            if (_ops) {
+                _ops->move(_storage, b._storage);
+                b._ops = nullptr;
+            }
+        }
+        return *this;
+    }
+    task(const task&) = delete;
+    task& operator = (const task&) = delete;
+    ~task(void) {
+        reset();
+    }
+    
+    inline void operator()(void) {
+        _ops->invoke(_storage);
+    }
+    inline explicit operator bool(void) const {
+        return _ops != nullptr;
+    }
+    inline void* owner(void) const {
+        return _owner;
+    }
+    /*type of the callable, call_t for tasks made by make_task*/
+    inline const std::type_info& type(void) const {
+        return _ops ? _ops->type() : typeid(void);
+    }
+    void reset(void) {
+        if (_ops) {
+            _ops->destroy(_storage);
+            _ops = nullptr;
+        }
+        _owner = nullptr;
+    }
+    
+private:
+    struct ops_base {
+        void (*invoke)(void*);
+        void (*move)(void* to, void* from);    /*move construct into to, then destroy from*/
+        void (*destroy)(void*);
+        const std::type_info& (*type)(void);
+    };
+    
+    template <class D, bool local = (sizeof(D) <= inline_size && alignof(D) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<D>::value)>
+    struct ops_t {//stored inline
+        template <class F> static void construct(void* p, F&& fn) {new (p) D(std::forward<F>(fn));}
+        static void invoke(void* p) {(*static_cast<D*>(p))();}
+        static void move(void* to, void* from) {new (to) D(std::move(*static_cast<D*>(from))); static_cast<D*>(from)->~D();}
+        static void destroy(void* p) {static_cast<D*>(p)->~D();}
+        static const std::type_info& type(void) {return typeid(D);}
+        static const ops_base* get(void) {
+            static const ops_base ops = {&invoke, &move, &destroy, &type};
+            return &ops;
+        }
+    };
+    template <class D>
+    struct ops_t<D, false> {//too large, stored on heap
+        template <class F> static void construct(void* p, F&& fn) {*static_cast<D**>(p) = new D(std::forward<F>(fn));}
+        static void invoke(void* p) {(**static_cast<D**>(p))();}
+        static void move(void* to, void* from) {*static_cast<D**>(to) = *static_cast<D**>(from);}
+        static void destroy(void* p) {delete *static_cast<D**>(p);}
+        static const std::type_info& type(void) {return typeid(D);}
+        static const ops_base* get(void) {
+            static const ops_base ops = {&invoke, &move, &destroy, &type};
+            return &ops;
+        }
+    };
+    
+    alignas(std::max_align_t) unsigned char _storage[inline_size];
+    const ops_base* _ops;
+    void*   _owner;
+};
+
 struct runnable : public life {
     struct bind_base_t {
     public:
@@ -64,8 +162,61 @@ struct runnable : public life {
     typedef int64_t task_id;
     static constexpr task_id invalid_task_id = -1;
     
+    /*while it is alive, tasks, cancels and listener changes made by this thread for target are held,
+     then published with one wakeup on commit|destruction, in the order they were made.
+     the loop thread of target applies them directly as usual*/
+    struct batch {
+        explicit batch(runnable* target = nullptr);
+        ~batch(void);
+        
+        void    commit(void);
+        size_t  size(void) const; //held actions
+        
+    private:
+        batch(const batch&) = delete;
+        batch& operator = (const batch&) = delete;
+        struct batch_cxt*   _cxt;
+    };
+    
+    /*scheduler counters, readable from any thread*/
+    struct stats_t {
+        uint64_t    allocated;  //action nodes taken from the global allocator
+        uint64_t    recycled;   //action nodes served from the free list of the runnable
+        uint64_t    parks;      //times the loop blocked in poller, each one costs a wakeup from producers or io
+        uint64_t    spinHits;   //idle periods ended by work found while busy-polling, wakeups saved
+        uint64_t    spinMisses; //busy-poll windows expired without work, then parked
+        uint64_t    spinTime;   //microseconds burned by busy-polling
+        uint64_t    slowTasks;  //tasks and listener callbacks over the threshold of setSlowTask
+        uint64_t    stalls;     //iterations flagged by the watchdog
+        size_t      queued;     //bulk tasks waiting to run
+        uint64_t    queuePeak;  //high-water mark of queued
+        uint64_t    rejected;   //pushes refused by the queue limit
+        uint64_t    dropped;    //bulk tasks dropped by OVERLOAD_DROP_OLDEST
+    };
+    
+    /*urgent lane is for latency critical work like io continuations, it runs first in every iteration and out of budget*/
+    /*continuation lane runs in bulk order but out of the queue limit, for library continuations which must not be lost*/
+    typedef enum {LANE_BULK = 0, LANE_URGENT, LANE_CONTINUATION} lane_t;
+    
+    /*what a push does while the bulk lane is full, see setQueueLimit*/
+    typedef enum {OVERLOAD_NONE = 0, OVERLOAD_REJECT, OVERLOAD_BLOCK, OVERLOAD_DROP_OLDEST} overload_t;
+    
+    /*cpu placement of a thread, see ts::runtime*/
+    struct placement_t {
+        std::vector<size_t> cores;  //cores allowed to run on, empty for the cores of node
+        int     node;               //numa node, used if cores is empty, -1 for no limit
+        
+        placement_t(void) : node(-1) {}
+        explicit placement_t(size_t core) : cores(1, core), node(-1) {}
+        explicit placement_t(const std::vector<size_t>& set) : cores(set), node(-1) {}
+        bool    empty(void) const { return cores.empty() && node < 0; }
+    };
+    
+    /*io multiplexing backend, epoll falls back to select*/
+    typedef enum {POLLER_DEFAULT = 0, POLLER_SELECT, POLLER_EPOLL} poller_t;
+    
 public:
-    runnable(const char* name);
+    runnable(const char* name, poller_t poller = POLLER_DEFAULT);
 protected:
     template<class _Tp> friend class std::shared_ptr;
     template<class _Tp> friend struct std::default_delete;
@@ -77,6 +228,12 @@ public:
     
     /*push task to current|specified thread*/
     static task_id  push(std::shared_ptr<bind_base_t> ca, int64_t miliseconds = 0, int64_t count = 1, runnable* target = nullptr);
+    static task_id  push(task&& ta, int64_t miliseconds = 0, int64_t count = 1, runnable* target = nullptr, lane_t lane = LANE_BULK);
+    /*push task with microsecond granularity*/
+    static task_id  push_us(std::shared_ptr<bind_base_t> ca, int64_t microseconds = 0, int64_t count = 1, runnable* target = nullptr);
+    static task_id  push_us(task&& ta, int64_t microseconds = 0, int64_t count = 1, runnable* target = nullptr, lane_t lane = LANE_BULK);
+    /*push tasks at once, see batch*/
+    static void     pushBatch(std::vector<task>& tasks, int64_t miliseconds = 0, runnable* target = nullptr);
     /*cancel task from current|specified thread*/
     static void     cancel(task_id id, runnable* target = nullptr);
     /*cancel task by owner*/
@@ -94,6 +251,7 @@ public:
     static void*    getValue(uint64_t key);
     
     static void     background(std::shared_ptr<bind_base_t> ca);
+    static void     background(task&& ta);
 
     bool    start(void);
     std::unique_ptr<std::thread>    stop(void);     //stop and clear scene
@@ -101,14 +259,34 @@ public:
     void    join(void);
     bool    running(void) const;
     bool    verify(bool log = true) const;
+    stats_t stats(void) const;
+    /*expired timers and bulk tasks run per iteration before polling io again, 0 for no limit, 1024 tasks and 2ms by default*/
+    void    setBudget(size_t tasks, int64_t microseconds);
+    /*spin on the queue and io for at most microseconds before parking, the window adapts to the idle gaps seen, 0 for off(default).
+      it burns cpu for latency, meant for runnables pinned on dedicated cores*/
+    void    setBusyPoll(int64_t microseconds);
+    /*pin the loop thread, applied at once if running, or when started*/
+    void    setPlacement(const placement_t& place);
+    placement_t placement(void) const;
+    /*bound bulk tasks waiting to run, delayed and urgent tasks are not counted, 0 for no limit(default).
+      a rejected push returns invalid_task_id, OVERLOAD_BLOCK waits at most timeout miliseconds before rejecting
+      and never blocks the runnable itself, OVERLOAD_DROP_OLDEST drops the oldest bulk tasks in the loop,
+      channel drains and server_group broadcasts are never refused, a refused ts::call settles its future with an error*/
+    void    setQueueLimit(size_t capacity, overload_t policy = OVERLOAD_REJECT, int64_t timeout = 0);
+    /*report tasks and listener callbacks running longer than microseconds with their owner and type, 0 for off(default)*/
+    void    setSlowTask(int64_t microseconds);
+    /*a shared watchdog thread reports the loop if an iteration does not complete within miliseconds, 0 for off(default)*/
+    void    setWatchdog(int64_t miliseconds);
+    /*pool for background tasks pushed from this runnable, nullptr for pool::shared()*/
+    void    setBackground(struct pool* target);
     
 private:
     virtual void    loop(void);
     
 private:
-    void    expansion_commit(void);
-    int64_t excute(void);
-    void    wait(int64_t);
+    int64_t excute(void);   //return microseconds to the next deadline, -1 if there is none
+    int     wait(int64_t);  //in microseconds, return number of io events dispatched
+    bool    spin(int64_t idle, int64_t timeout);   //busy-poll before parking, return true if work arrived
     void    loop_join(void);
     
 private:
@@ -132,6 +310,12 @@ void apply_tuple_impl(O p, F&& fn, Tuple&& t, types::__index_t<S...>) {
     return (p->*fn)(std::get<S>(t)...);
 }
 
+//one-shot version, bound arguments are moved into the call
+template<typename... Args, typename O, typename F, typename Tuple, size_t ...S >
+void apply_tuple_once(O p, F&& fn, Tuple& t, types::__index_t<S...>) {
+    return (p->*fn)(std::forward<Args>(std::get<S>(t))...);
+}
+
 template <class T, typename... Args>
 struct bind_t : public runnable::bind_base_t {
 protected:
@@ -147,7 +331,8 @@ private:
     _Fd __f_;
     _Td __bound_args_;
 public:
-    explicit bind_t(_Cp& __p, _Fp& __f, Args&& ...__bound_args) : __o_(__p->clone()), __p_(__p), __f_(__f), __bound_args_(std::forward<Args>(__bound_args)...) {}
+    template <typename... Params>
+    explicit bind_t(_Cp __p, _Fp __f, Params&& ...__bound_args) : __o_(__p->clone()), __p_(__p), __f_(__f), __bound_args_(std::forward<Params>(__bound_args)...) {}
 private:
     void invoke(void) {
         apply_tuple_impl(__p_, __f_, __bound_args_, __indices());
@@ -155,50 +340,110 @@ private:
     void* owner(void) {return __o_.get();}
 };
 
-template <class T, typename... Args>
-std::shared_ptr<runnable::bind_base_t> make_bind(T* ptr, void (T::*f)(Args... args), Args... args) {
-    return std::shared_ptr<runnable::bind_base_t>(new bind_t<T, Args...>(ptr, f, std::forward<Args>(args)...));
+//the same call as bind_t, without vtable, to be stored inline of a task
+//once is true if it is invoked one time at most, then bound arguments are moved out to the callee
+template <bool once, class T, typename... Args>
+struct call_t {
+protected:
+    typedef typename std::shared_ptr<ts::life> _Od;
+    typedef T* _Cp;
+    typedef void (T::*_Fp)(Args...);
+    typedef typename std::decay<_Fp>::type _Fd;
+    typedef std::tuple<typename std::decay<Args>::type...> _Td;
+    typedef typename types::make_indices<sizeof...(Args)>::__type __indices;
+private:
+    _Od __o_;
+    _Cp __p_;
+    _Fd __f_;
+    _Td __bound_args_;
+public:
+    template <typename... Params>
+    explicit call_t(_Cp __p, _Fp __f, Params&& ...__bound_args) : __o_(__p->clone()), __p_(__p), __f_(__f), __bound_args_(std::forward<Params>(__bound_args)...) {}
+    void operator()(void) {
+        invoke(std::integral_constant<bool, once>());
+    }
+    void* owner(void) const {return __o_.get();}
+private:
+    void invoke(std::true_type) {
+        apply_tuple_once<Args...>(__p_, __f_, __bound_args_, __indices());
+    }
+    void invoke(std::false_type) {
+        apply_tuple_impl(__p_, __f_, __bound_args_, __indices());
+    }
+};
+
+template <bool once, class T, typename... Args, typename... Params>
+task make_task(T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    static_assert(sizeof...(Args) == sizeof...(Params), "argument count mismatched");
+    call_t<once, T, Args...> c(ptr, f, std::forward<Params>(params)...);
+    void* own = c.owner();
+    return task(std::move(c), own);
 }
 
-template <class T, typename... Args>
-runnable::task_id repeat(int64_t miliseconds, int64_t count, T* ptr, void (T::*f)(Args... args), Args... args) {
-    std::shared_ptr<runnable::bind_base_t> bind(new bind_t<T, Args...>(ptr, f, std::forward<Args>(args)...));
-    return runnable::push(bind, miliseconds, count);
+template <class T, typename... Args, typename... Params>
+std::shared_ptr<runnable::bind_base_t> make_bind(T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    static_assert(sizeof...(Args) == sizeof...(Params), "argument count mismatched");
+    return std::shared_ptr<runnable::bind_base_t>(new bind_t<T, Args...>(ptr, f, std::forward<Params>(params)...));
 }
 
-template <class T, typename... Args>
-runnable::task_id repeat2(std::shared_ptr<runnable> target, int64_t miliseconds, int64_t count, T* ptr, void (T::*f)(Args... args), Args... args) {
-    std::shared_ptr<runnable::bind_base_t> bind(new bind_t<T, Args...>(ptr, f, std::forward<Args>(args)...));
-    return runnable::push(bind, miliseconds, count, target.get());
+template <class T, typename... Args, typename... Params>
+runnable::task_id repeat(int64_t miliseconds, int64_t count, T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push(make_task<false>(ptr, f, std::forward<Params>(params)...), miliseconds, count);
 }
 
-template <class T, typename... Args>
-runnable::task_id delay(int64_t miliseconds, T* ptr, void (T::*f)(Args... args), Args... args) {
-    return repeat(miliseconds, 1, ptr, f, std::forward<Args>(args)...);
+template <class T, typename... Args, typename... Params>
+runnable::task_id repeat2(std::shared_ptr<runnable> target, int64_t miliseconds, int64_t count, T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push(make_task<false>(ptr, f, std::forward<Params>(params)...), miliseconds, count, target.get());
 }
 
-template <class T, typename... Args>
-runnable::task_id delay2(std::shared_ptr<runnable> target, int64_t miliseconds, T* ptr, void (T::*f)(Args... args), Args... args) {
-    return repeat2(target, miliseconds, 1, ptr, f, std::forward<Args>(args)...);
+template <class T, typename... Args, typename... Params>
+runnable::task_id delay(int64_t miliseconds, T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push(make_task<true>(ptr, f, std::forward<Params>(params)...), miliseconds, 1);
 }
 
-template <class T, typename... Args>
-runnable::task_id asyn(T* ptr, void (T::*f)(Args... args), Args... args) {
-    return repeat(0, 1, ptr, f, std::forward<Args>(args)...);
+template <class T, typename... Args, typename... Params>
+runnable::task_id delay2(std::shared_ptr<runnable> target, int64_t miliseconds, T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push(make_task<true>(ptr, f, std::forward<Params>(params)...), miliseconds, 1, target.get());
 }
 
-template <class T, typename... Args>
-runnable::task_id asyn2(std::shared_ptr<runnable> target, T* ptr, void (T::*f)(Args... args), Args... args) {
-    return repeat2(target, 0, 1, ptr, f, std::forward<Args>(args)...);
+template <class T, typename... Args, typename... Params>
+runnable::task_id repeat_us(int64_t microseconds, int64_t count, T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push_us(make_task<false>(ptr, f, std::forward<Params>(params)...), microseconds, count);
 }
 
-template <class T, typename... Args>
-void slide(T* ptr, void (T::*f)(Args... args), Args... args) {
-    std::shared_ptr<runnable::bind_base_t> bind(new bind_t<T, Args...>(ptr, f, std::forward<Args>(args)...));
-    return runnable::background(bind);
+template <class T, typename... Args, typename... Params>
+runnable::task_id delay_us(int64_t microseconds, T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push_us(make_task<true>(ptr, f, std::forward<Params>(params)...), microseconds, 1);
+}
+
+template <class T, typename... Args, typename... Params>
+runnable::task_id asyn(T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push(make_task<true>(ptr, f, std::forward<Params>(params)...), 0, 1);
+}
+
+template <class T, typename... Args, typename... Params>
+runnable::task_id asyn2(std::shared_ptr<runnable> target, T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push(make_task<true>(ptr, f, std::forward<Params>(params)...), 0, 1, target.get());
+}
+
+template <class T, typename... Args, typename... Params>
+runnable::task_id urgent(T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push(make_task<true>(ptr, f, std::forward<Params>(params)...), 0, 1, nullptr, runnable::LANE_URGENT);
+}
+
+template <class T, typename... Args, typename... Params>
+runnable::task_id urgent2(std::shared_ptr<runnable> target, T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::push(make_task<true>(ptr, f, std::forward<Params>(params)...), 0, 1, target.get(), runnable::LANE_URGENT);
+}
+
+template <class T, typename... Args, typename... Params>
+void slide(T* ptr, void (T::*f)(Args... args), Params&&... params) {
+    return runnable::background(make_task<true>(ptr, f, std::forward<Params>(params)...));
 }
 
 int64_t     getUptimeInMilliseconds(void);
+int64_t     getUptimeInMicroseconds(void);  //monotonic
+int64_t     getUptimeInNanoseconds(void);   //monotonic
 uint64_t    getThreadId(void);
 
 _TS_NAMESPACE_END
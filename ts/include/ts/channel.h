@@ -0,0 +1,375 @@
+/* ====================================================================
+ * Copyright (c) 2018-2022 The TS Project.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ====================================================================
+ */
+#if !defined(_TS_CHANNEL_INC_)
+#define _TS_CHANNEL_INC_
+#pragma once
+
+#include <ts/tss.h>
+#include <ts/asyn.h>
+#include <ts/log.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <functional>
+
+_TS_NAMESPACE_BEGIN
+
+//for rings
+//_______________________________________________________________________________________________________________
+inline size_t ring_capacity(size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) n <<= 1;
+    return n;
+}
+
+/*bounded single producer single consumer ring, each side caches the index of the other one*/
+template<typename T>
+struct spsc_ring {
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type slot_t;
+    
+    explicit spsc_ring(size_t capacity) : _mask(ring_capacity(capacity) - 1), _slots(new slot_t[_mask + 1]), _tail(0), _headCache(0), _head(0), _tailCache(0) {}
+    ~spsc_ring(void) {
+        T one;
+        while (pop(one));
+    }
+    
+    size_t  capacity(void) const { return _mask + 1; }
+    size_t  size(void) const { return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire); }
+    
+    template<typename U>
+    bool push(U&& value) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _headCache > _mask) {
+            _headCache = _head.load(std::memory_order_acquire);
+            if (tail - _headCache > _mask) {
+                return false;
+            }
+        }
+        new (&_slots[tail & _mask]) T(std::forward<U>(value));
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    
+    bool pop(T& value) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tailCache) {
+            _tailCache = _tail.load(std::memory_order_acquire);
+            if (head == _tailCache) {
+                return false;
+            }
+        }
+        T* one = reinterpret_cast<T*>(&_slots[head & _mask]);
+        value = std::move(*one);
+        one->~T();
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    
+private:
+    //padded rather than alignas(64), which operator new does not honour before c++17
+    const size_t _mask;
+    std::unique_ptr<slot_t[]> _slots;
+    char    _pad0[64 - sizeof(size_t) - sizeof(std::unique_ptr<slot_t[]>)];
+    std::atomic<size_t> _tail;  /*producer side*/
+    size_t  _headCache;
+    char    _pad1[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    std::atomic<size_t> _head;  /*consumer side*/
+    size_t  _tailCache;
+    char    _pad2[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+/*bounded multiple producer single consumer ring(Vyukov), every slot has a sequence telling whose turn it is*/
+template<typename T>
+struct mpsc_ring {
+    struct cell_t {
+        std::atomic<size_t> seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+    };
+    
+    explicit mpsc_ring(size_t capacity) : _mask(ring_capacity(capacity) - 1), _cells(new cell_t[_mask + 1]), _tail(0), _head(0) {
+        for (size_t i = 0; i <= _mask; i++) {
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+    ~mpsc_ring(void) {
+        T one;
+        while (pop(one));
+    }
+    
+    size_t  capacity(void) const { return _mask + 1; }
+    size_t  size(void) const {
+        size_t tail = _tail.load(std::memory_order_acquire);
+        size_t head = _head.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+    
+    template<typename U>
+    bool push(U&& value) {
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        cell_t* cell = nullptr;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            intptr_t diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)pos;
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {//full
+                return false;
+            }
+            else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+        new (&cell->data) T(std::forward<U>(value));
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    
+    //consumer only
+    bool pop(T& value) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        cell_t* cell = &_cells[head & _mask];
+        if (cell->seq.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        T* one = reinterpret_cast<T*>(&cell->data);
+        value = std::move(*one);
+        one->~T();
+        cell->seq.store(head + _mask + 1, std::memory_order_release);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    
+private:
+    //padded rather than alignas(64), which operator new does not honour before c++17
+    const size_t _mask;
+    std::unique_ptr<cell_t[]> _cells;
+    char    _pad0[64 - sizeof(size_t) - sizeof(std::unique_ptr<cell_t[]>)];
+    std::atomic<size_t> _tail;
+    char    _pad1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _head;
+    char    _pad2[64 - sizeof(std::atomic<size_t>)];
+};
+
+//for channel
+//_______________________________________________________________________________________________________________
+/*bounded channel whose consumer is a runnable, T must be default constructible and movable.
+ the first push into an empty channel posts a drain task to the consumer, it hands up to batch items at once to handler,
+ and posts itself again if there are more, so a busy channel shares the loop with io and timers(see runnable::setBudget).
+ push fails while the channel is full, that is the backpressure signal, whenWritable tells when to go on.
+ 
+    auto ch = ts::mpsc_channel<packet>::create(4096, parser, [](std::vector<packet>& items) {...});
+    if (!ch->push(std::move(pkt))) {
+        ch->whenWritable(task([]() {...resume reading...}));
+    }
+ */
+template<typename T, typename Ring = spsc_ring<T>>
+struct channel : public std::enable_shared_from_this<channel<T, Ring>> {
+    typedef std::function<void(std::vector<T>& items)> handler_t;
+    
+    struct stats_t {
+        uint64_t    pushed;
+        uint64_t    rejected;   //pushes failed by full
+        uint64_t    drains;     //handler calls
+    };
+    
+    /**
+     @capacity  - rounded up to power of 2
+     @consumer  - runnable the handler runs on
+     @batch     - items per handler call at most
+     */
+    static std::shared_ptr<channel> create(size_t capacity, runnable* consumer, handler_t handler, size_t batch = 64) {
+        if (consumer == nullptr || !handler || batch == 0) {
+            log_error("illegal argment!");
+            return nullptr;
+        }
+        return std::shared_ptr<channel>(new channel(capacity, consumer, handler, batch));
+    }
+    
+    /*false if full or closed*/
+    template<typename U>
+    bool    push(U&& value) {
+        if (_closed.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (!_ring.push(std::forward<U>(value))) {
+            _rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _pushed.fetch_add(1, std::memory_order_relaxed);
+        schedule();
+        return true;
+    }
+    
+    /*move items in as many as possible with one wakeup, the rest are left in items, return count pushed*/
+    size_t  push(std::vector<T>& items) {
+        if (_closed.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        size_t count = 0;
+        while (count < items.size() && _ring.push(std::move(items[count]))) {
+            count++;
+        }
+        if (count < items.size()) {
+            _rejected.fetch_add(1, std::memory_order_relaxed);
+        }
+        items.erase(items.begin(), items.begin() + count);
+        if (count) {
+            _pushed.fetch_add(count, std::memory_order_relaxed);
+            schedule();
+        }
+        return count;
+    }
+    
+    /*ta runs on target once the channel is drained to half, at once if it is already*/
+    void    whenWritable(task&& ta, runnable* target = runnable::current()) {
+        {
+            std::lock_guard<std::mutex> _auto_lock(_lock);
+            _writable = std::move(ta);
+            _writableTarget = target;
+            _waiting.store(true, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_ring.size() <= _ring.capacity() / 2) {
+            writable();
+        }
+    }
+    
+    /*refuse pushes, items queued are still handled*/
+    void    close(void) { _closed.store(true, std::memory_order_relaxed); }
+    bool    closed(void) const { return _closed.load(std::memory_order_relaxed); }
+    
+    size_t  size(void) const { return _ring.size(); }
+    size_t  capacity(void) const { return _ring.capacity(); }
+    bool    full(void) const { return _ring.size() >= _ring.capacity(); }
+    
+    stats_t stats(void) const {
+        stats_t st;
+        st.pushed   = _pushed.load(std::memory_order_relaxed);
+        st.rejected = _rejected.load(std::memory_order_relaxed);
+        st.drains   = _drains.load(std::memory_order_relaxed);
+        return st;
+    }
+    
+private:
+    channel(size_t capacity, runnable* consumer, handler_t handler, size_t batch) : _ring(capacity), _consumer(consumer), _handler(handler), _batch(batch), _scheduled(false), _closed(false), _waiting(false), _writableTarget(nullptr), _pushed(0), _rejected(0), _drains(0) {
+        _items.reserve(batch);
+    }
+    channel(const channel&) = delete;
+    channel& operator = (const channel&) = delete;
+    
+    //pairs with the fence in drain, a drain is posted on the edge from empty only
+    void    schedule(void) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!_scheduled.load(std::memory_order_relaxed) && !_scheduled.exchange(true, std::memory_order_acq_rel)) {
+            post();
+        }
+    }
+    
+    //bulk order to share the loop fairly, out of the queue limit of consumer since a refused or dropped drain
+    //would leave _scheduled set and the channel never drains again
+    void    post(void) {
+        std::shared_ptr<channel> self = this->shared_from_this();
+        if (runnable::push(task([self]() {
+            self->drain();
+        }), 0, 1, _consumer, runnable::LANE_CONTINUATION) == runnable::invalid_task_id) {
+            _scheduled.store(false, std::memory_order_relaxed); /*let the next push try again*/
+        }
+    }
+    
+    void    drain(void) {
+        T one;
+        while (_items.size() < _batch && _ring.pop(one)) {
+            _items.push_back(std::move(one));
+        }
+        if (_items.size()) {
+            _drains.store(_drains.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            _handler(_items);
+            _items.clear();
+        }
+        //pairs with the fence in whenWritable: pops are visible to it, or its _waiting is visible here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_waiting.load(std::memory_order_relaxed) && _ring.size() <= _ring.capacity() / 2) {
+            writable();
+        }
+        if (_ring.size()) {//more, after other work of the loop
+            post();
+            return;
+        }
+        _scheduled.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_ring.size() && !_scheduled.exchange(true, std::memory_order_acq_rel)) {
+            post();
+        }
+    }
+    
+    void    writable(void) {
+        task ta;
+        runnable* target = nullptr;
+        {
+            std::lock_guard<std::mutex> _auto_lock(_lock);
+            if (!_waiting.load(std::memory_order_relaxed)) {
+                return;
+            }
+            _waiting.store(false, std::memory_order_relaxed);
+            ta = std::move(_writable);
+            target = _writableTarget;
+        }
+        if (!ta) {
+            return;
+        }
+        if (target) {
+            runnable::push(std::move(ta), 0, 1, target, runnable::LANE_URGENT);
+        }
+        else {
+            ta();
+        }
+    }
+    
+private:
+    Ring        _ring;
+    runnable*   _consumer;
+    handler_t   _handler;
+    size_t      _batch;
+    std::vector<T>  _items;     /*consumer only*/
+    std::atomic<bool>   _scheduled; /*a drain is posted or running*/
+    std::atomic<bool>   _closed;
+    
+    std::mutex  _lock;      /*for backpressure callback*/
+    std::atomic<bool>   _waiting;
+    task        _writable;
+    runnable*   _writableTarget;
+    
+    std::atomic<uint64_t>   _pushed;
+    std::atomic<uint64_t>   _rejected;
+    std::atomic<uint64_t>   _drains;
+};
+
+template<typename T>
+using spsc_channel = channel<T, spsc_ring<T>>;
+
+template<typename T>
+using mpsc_channel = channel<T, mpsc_ring<T>>;
+
+_TS_NAMESPACE_END
+
+#endif /*_TS_CHANNEL_INC_*/
@@ -0,0 +1,331 @@
+/* ====================================================================
+ * Copyright (c) 2018-2022 The TS Project.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ====================================================================
+ */
+#if !defined(_TS_CORO_INC_)
+#define _TS_CORO_INC_
+#pragma once
+
+#include <ts/tss.h>
+#include <ts/asyn.h>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <ts/log.h>
+
+_TS_NAMESPACE_BEGIN
+
+/*c++20 coroutines on runnable, a suspended coroutine is resumed by the loop thread it is waiting on,
+ resuming is a task of the urgent lane which holds the coroutine handle inline, no allocation per step.
+ 
+    coro::job serve(int fd) {
+        co_await coro::hop(reactor);
+        coro::watch io(fd);
+        for (;;) {
+            coro::io_t ev = co_await io.readable();
+            if (ev.closed) break;
+            ...
+            std::string reply = co_await coro::background([] { return heavy(); });
+            co_await coro::sleep(10);
+        }
+    }
+ 
+ frames suspended on a runnable which is stopped or reset are leaked, the same as other tasks of it.
+ */
+namespace coro {
+    //for awaiters
+    //_______________________________________________________________________________________________________________
+    inline void resume(std::coroutine_handle<> handle, runnable* target) {
+        runnable::push(task([handle]() {
+            handle.resume();
+        }), 0, 1, target, runnable::LANE_URGENT);
+    }
+    
+    /*resume on the current runnable after miliseconds, by the delay queue*/
+    struct sleep {
+        explicit sleep(int64_t miliseconds) : _microseconds(miliseconds * 1000) {}
+        
+        bool    await_ready(void) const noexcept { return _microseconds <= 0; }
+        bool    await_suspend(std::coroutine_handle<> handle) {
+            if (runnable::current() == nullptr) {//no delay queue to wait on
+                log_error("sleep out of runnable!");
+                return false;
+            }
+            runnable::push_us(task([handle]() {
+                handle.resume();
+            }), _microseconds, 1, nullptr, runnable::LANE_URGENT);
+            return true;
+        }
+        void    await_resume(void) const noexcept {}
+        
+    protected:
+        int64_t _microseconds;
+    };
+    
+    struct sleep_us : sleep {
+        explicit sleep_us(int64_t microseconds) : sleep(0) { _microseconds = microseconds; }
+    };
+    
+    /*continue on target, resume at once if it is the current one*/
+    struct hop {
+        explicit hop(runnable* target) : _target(target) {}
+        explicit hop(runnable& target) : _target(&target) {}
+        
+        bool    await_ready(void) const noexcept { return _target == runnable::current(); }
+        void    await_suspend(std::coroutine_handle<> handle) { resume(handle, _target); }
+        void    await_resume(void) const noexcept {}
+        
+    private:
+        runnable*   _target;
+    };
+    
+    struct io_t {
+        bool    readable;
+        bool    writable;
+        bool    closed;
+        size_t  size;   //bytes to read if readable
+    };
+    
+    /*waits for fd by the poller of the runnable it is first awaited on, the fd must not have another listener.
+     the registration is kept across awaits, an event coming while nobody waits unlistens fd until the next await,
+     so a loop of awaiting and reading costs no poller call. destroy it on the same runnable.
+     waiting writable also ends if the fd becomes readable first, check the result*/
+    struct watch : runnable::listener {
+        struct awaiter {
+            watch&  _watch;
+            bool    _writable;
+            
+            bool    await_ready(void) const noexcept { return _watch._closed; }
+            void    await_suspend(std::coroutine_handle<> handle) { _watch.wait(handle, _writable); }
+            io_t    await_resume(void) const noexcept { return _watch._closed ? io_t{false, false, true, 0} : _watch._result; }
+        };
+        
+        explicit watch(int fd) : _fd(fd), _host(nullptr), _listening(false), _closed(false), _result{false, false, false, 0} {}
+        ~watch(void) {
+            if (_listening) {
+                runnable::removeListener(_fd, _host);
+            }
+        }
+        
+        awaiter readable(void) { return awaiter{*this, false}; }
+        awaiter writable(void) { return awaiter{*this, true}; }
+        
+    private:
+        watch(const watch&) = delete;
+        watch& operator = (const watch&) = delete;
+        
+        void wait(std::coroutine_handle<> handle, bool writable) {
+            _handle = handle;
+            _result = io_t{false, false, false, 0};
+            if (!_listening) {
+                _host = runnable::current();
+                runnable::addListener(this, _fd, _host);
+                _listening = true;
+            }
+            if (writable) {
+                runnable::wantWritable(_fd, true, _host);
+            }
+        }
+        void onRecv(int /*fd*/, size_t size) override {
+            if (!_handle) {//not awaited, level triggered, it would come again every iteration
+                runnable::removeListener(_fd, _host);
+                _listening = false;
+                return;
+            }
+            _result.readable = true;
+            _result.size = size;
+            wake();
+        }
+        void onWritable(int /*fd*/) override {
+            if (_handle) {
+                _result.writable = true;
+                wake();
+            }
+        }
+        void onClose(int /*fd*/) override {//listener is removed already
+            _listening = false;
+            _closed = true;
+            if (_handle) {
+                wake();
+            }
+        }
+        //the coroutine may destroy this while resumed
+        void wake(void) {
+            std::coroutine_handle<> handle = _handle;
+            _handle = nullptr;
+            handle.resume();
+        }
+        
+    private:
+        int         _fd;
+        runnable*   _host;
+        bool        _listening;
+        bool        _closed;
+        io_t        _result;
+        std::coroutine_handle<> _handle;
+    };
+    
+    /*run fn on the background pool of the current runnable, resume on it with the result or the exception*/
+    template<typename F, typename R = std::invoke_result_t<F>>
+    struct background_awaiter {
+        explicit background_awaiter(F&& fn) : _fn(std::move(fn)) {}
+        
+        bool    await_ready(void) const noexcept { return false; }
+        void    await_suspend(std::coroutine_handle<> handle) {
+            runnable* host = runnable::current();
+            runnable::background(task([this, handle, host]() {
+                try {
+                    if constexpr (std::is_void_v<R>) {
+                        _fn();
+                    }
+                    else {
+                        _value.emplace(_fn());
+                    }
+                }
+                catch (...) {
+                    _error = std::current_exception();
+                }
+                if (host) {
+                    resume(handle, host);
+                }
+                else {//not from a runnable, go on in the pool
+                    handle.resume();
+                }
+            }));
+        }
+        R       await_resume(void) {
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+            if constexpr (!std::is_void_v<R>) {
+                return std::move(*_value);
+            }
+        }
+        
+    private:
+        F   _fn;
+        std::exception_ptr  _error;
+        std::optional<std::conditional_t<std::is_void_v<R>, char, R>> _value;
+    };
+    
+    template<typename F>
+    background_awaiter<std::decay_t<F>> background(F&& fn) {
+        return background_awaiter<std::decay_t<F>>(std::decay_t<F>(std::forward<F>(fn)));
+    }
+    
+    //for coroutine types
+    //_______________________________________________________________________________________________________________
+    /*detached coroutine, starts at once and frees itself when done, the root of a handler*/
+    struct job {
+        struct promise_type {
+            job     get_return_object(void) noexcept { return job(); }
+            std::suspend_never  initial_suspend(void) noexcept { return {}; }
+            std::suspend_never  final_suspend(void) noexcept { return {}; }
+            void    return_void(void) noexcept {}
+            void    unhandled_exception(void) noexcept {
+                try {
+                    std::rethrow_exception(std::current_exception());
+                }
+                catch (const std::exception& e) {
+                    log_error("unhandled exception in coroutine: %s!", e.what());
+                }
+                catch (...) {
+                    log_error("unhandled exception in coroutine!");
+                }
+            }
+        };
+    };
+    
+    template<typename T>
+    struct promise_value {
+        std::optional<T>    _value;
+        std::exception_ptr  _error;
+        
+        template<typename U>
+        void    return_value(U&& value) { _value.emplace(std::forward<U>(value)); }
+        T       result(void) {
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+            return std::move(*_value);
+        }
+    };
+    
+    template<>
+    struct promise_value<void> {
+        std::exception_ptr  _error;
+        
+        void    return_void(void) noexcept {}
+        void    result(void) {
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+        }
+    };
+    
+    /*lazy coroutine with a result, starts when awaited and resumes the awaiter when done*/
+    template<typename T = void>
+    struct async {
+        struct promise_type : promise_value<T> {
+            std::coroutine_handle<>  _continuation;
+            
+            async   get_return_object(void) noexcept { return async(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend(void) noexcept { return {}; }
+            auto    final_suspend(void) noexcept {
+                struct final_awaiter {
+                    bool    await_ready(void) const noexcept { return false; }
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                        std::coroutine_handle<> next = handle.promise()._continuation;
+                        return next ? next : std::noop_coroutine();
+                    }
+                    void    await_resume(void) const noexcept {}
+                };
+                return final_awaiter();
+            }
+            void    unhandled_exception(void) noexcept { this->_error = std::current_exception(); }
+        };
+        
+        async(async&& b) noexcept : _handle(b._handle) { b._handle = nullptr; }
+        ~async(void) {
+            if (_handle) _handle.destroy();
+        }
+        
+        bool    await_ready(void) const noexcept { return !_handle || _handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+            _handle.promise()._continuation = awaiter;
+            return _handle;
+        }
+        T       await_resume(void) { return _handle.promise().result(); }
+        
+    private:
+        explicit async(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+        async(const async&) = delete;
+        async& operator = (const async&) = delete;
+        
+        std::coroutine_handle<promise_type> _handle;
+    };
+}
+
+_TS_NAMESPACE_END
+
+#endif /*__cpp_impl_coroutine*/
+
+#endif /*_TS_CORO_INC_*/
@@ -0,0 +1,68 @@
+/* ====================================================================
+ * Copyright (c) 2018-2022 The TS Project.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ====================================================================
+ */
+#if !defined(_TS_FILE_INC_)
+#define _TS_FILE_INC_
+#pragma once
+
+#include <ts/tss.h>
+#include <ts/asyn.h>
+#include <ts/pie.h>
+
+_TS_NAMESPACE_BEGIN
+
+/*async file io, completions are pushed as urgent tasks to the runnable calling it,
+ or run on the io thread if not called from a runnable.
+ backed by a small pool of io threads doing blocking calls, or by io_uring if asked by setEngine(ENGINE_URING) and available.
+ */
+struct file {
+    typedef enum {ENGINE_DEFAULT = 0, ENGINE_POOL, ENGINE_URING} engine_t;
+
+    struct result_t {
+        int         err;    //0 for success, errno otherwise
+        int         fd;     //by open
+        int64_t     size;   //bytes read or written, size of file by stat and readFile
+        uint32_t    mode;   //by stat
+        int64_t     mtime;  //by stat, seconds since epoch
+        std::shared_ptr<std::string>    data;   //by read and readFile
+    };
+    typedef std::function<void(result_t& res)> callback_t;
+
+    static void open(const char* path, int flags, int mode, callback_t cb);
+    static void close(int fd, callback_t cb = nullptr);
+    /*offset -1 for the current position of fd, data is shrinked to bytes read*/
+    static void read(int fd, size_t size, int64_t offset, callback_t cb);
+    /*data is held until completion, short writes are continued*/
+    static void write(int fd, std::shared_ptr<std::string> data, int64_t offset, callback_t cb);
+    static void fsync(int fd, callback_t cb);
+    static void stat(const char* path, callback_t cb);
+    /*stat, open, read and close in a row*/
+    static void readFile(const char* path, callback_t cb);
+    /*readFile and parse on the io side, only cb goes to the calling runnable, for json and xml*/
+    typedef std::function<bool(const char* data, pie& out, std::string& err)> parser_t;
+    typedef std::function<void(bool ok, pie& out, std::string& err)> loaded_t;
+    static void loadFile(const char* path, parser_t parser, loaded_t cb);
+
+    /*must be called before first request, return the engine in effect, ENGINE_DEFAULT is ENGINE_POOL*/
+    static engine_t setEngine(engine_t engine);
+    static engine_t engine(void);
+};
+
+_TS_NAMESPACE_END
+
+#endif /*_TS_FILE_INC_*/
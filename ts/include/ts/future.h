@@ -0,0 +1,416 @@
+/* ====================================================================
+ * Copyright (c) 2018-2022 The TS Project.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ====================================================================
+ */
+#if !defined(_TS_FUTURE_INC_)
+#define _TS_FUTURE_INC_
+#pragma once
+
+#include <ts/tss.h>
+#include <ts/asyn.h>
+#include <ts/log.h>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+_TS_NAMESPACE_BEGIN
+
+/*results of cross runnable calls without extra threads.
+ a promise and its futures share one state allocated once, a continuation is a task stored inline of it,
+ it is pushed to the runnable chosen by then(), or invoked by the thread settling the promise if there is none.
+ 
+    ts::call(db, [key]() { return load(key); })
+        .then([](record r) { return render(r); }, web)
+        .then([](std::string page) { ... });
+ 
+ a promise destroyed unsettled breaks its future with std::runtime_error.
+ */
+template<typename T> struct future;
+template<typename T> struct promise;
+
+//for shared state
+//_______________________________________________________________________________________________________________
+template<typename T>
+struct future_state {
+    typedef typename std::conditional<std::is_void<T>::value, char, T>::type value_t;
+    enum {READY = 1, CHAINED = 2};
+    
+    std::atomic<int>    _flags;
+    std::exception_ptr  _error;
+    bool        _has;
+    typename std::aligned_storage<sizeof(value_t), alignof(value_t)>::type _value;
+    task        _next;
+    runnable*   _target;
+    
+    future_state(void) : _flags(0), _has(false), _target(nullptr) {}
+    ~future_state(void) {
+        if (_has) value().~value_t();
+    }
+    
+    value_t&    value(void) { return *reinterpret_cast<value_t*>(&_value); }
+    bool        ready(void) const { return (_flags.load(std::memory_order_acquire) & READY) != 0; }
+    
+    //the value or error is written before READY is published, false if settled already
+    template<typename... Params>
+    bool setValue(Params&&... params) {
+        if (_flags.load(std::memory_order_relaxed) & READY) {
+            return false;
+        }
+        new (&_value) value_t(std::forward<Params>(params)...);
+        _has = true;
+        settle();
+        return true;
+    }
+    bool setError(std::exception_ptr error) {
+        if (_flags.load(std::memory_order_relaxed) & READY) {
+            return false;
+        }
+        _error = error;
+        settle();
+        return true;
+    }
+    //one of settle and chain sees both flags, it fires the continuation
+    void chain(task&& next, runnable* target) {
+        _next = std::move(next);
+        _target = target;
+        if (_flags.fetch_or(CHAINED, std::memory_order_acq_rel) & READY) {
+            fire();
+        }
+    }
+    
+private:
+    void settle(void) {
+        if (_flags.fetch_or(READY, std::memory_order_acq_rel) & CHAINED) {
+            fire();
+        }
+    }
+    void fire(void) {
+        task next(std::move(_next)); /*breaks the reference cycle through the continuation*/
+        if (_target) {
+            runnable::push(std::move(next), 0, 1, _target, runnable::LANE_URGENT);
+        }
+        else {
+            next();
+        }
+    }
+};
+
+//invoke fn with the value of a settled state, result goes to another state
+template<typename R>
+struct future_invoke {
+    template<typename F, typename S>
+    static void apply(F& fn, S& from, future_state<R>& to, std::true_type /*void value*/) { to.setValue(fn()); }
+    template<typename F, typename S>
+    static void apply(F& fn, S& from, future_state<R>& to, std::false_type) { to.setValue(fn(std::move(from.value()))); }
+};
+
+template<>
+struct future_invoke<void> {
+    template<typename F, typename S>
+    static void apply(F& fn, S& from, future_state<void>& to, std::true_type) { fn(); to.setValue(); }
+    template<typename F, typename S>
+    static void apply(F& fn, S& from, future_state<void>& to, std::false_type) { fn(std::move(from.value())); to.setValue(); }
+};
+
+template<typename F, typename T>
+struct future_result {
+    typedef decltype(std::declval<F&>()(std::declval<T&&>())) type;
+};
+
+template<typename F>
+struct future_result<F, void> {
+    typedef decltype(std::declval<F&>()()) type;
+};
+
+//for future
+//_______________________________________________________________________________________________________________
+template<typename T>
+struct future {
+    typedef future_state<T> state_t;
+    
+    future(void) {}
+    future(future&& b) : _state(std::move(b._state)) {}
+    future& operator = (future&& b) {
+        _state = std::move(b._state);
+        return *this;
+    }
+    
+    bool    valid(void) const { return _state != nullptr; }
+    bool    ready(void) const { return _state && _state->ready(); }
+    
+    /*fn(T) runs on target when settled, nullptr for the thread settling it, errors skip fn and pass through.
+     one continuation per future, the future is consumed*/
+    template<typename F, typename R = typename future_result<F, T>::type>
+    future<R>   then(F&& fn, runnable* target = runnable::current()) {
+        future<R> next;
+        if (!_state) {
+            log_error("illegal call!");
+            return next;
+        }
+        std::shared_ptr<future_state<R>> to = std::make_shared<future_state<R>>();
+        next._state = to;
+        std::shared_ptr<state_t> from = std::move(_state);
+        state_t* source = from.get();
+        typename std::decay<F>::type fx(std::forward<F>(fn));
+        source->chain(task([from, to, fx]() mutable {
+            if (from->_error) {
+                to->setError(from->_error);
+                return;
+            }
+            try {
+                future_invoke<R>::apply(fx, *from, *to, std::is_void<T>());
+            }
+            catch (...) {
+                to->setError(std::current_exception());
+            }
+        }), target);
+        return next;
+    }
+    
+    /*fn(std::exception_ptr) runs on target if failed*/
+    template<typename F>
+    void    fail(F&& fn, runnable* target = runnable::current()) {
+        if (!_state) {
+            log_error("illegal call!");
+            return;
+        }
+        std::shared_ptr<state_t> from = std::move(_state);
+        state_t* source = from.get();
+        typename std::decay<F>::type fx(std::forward<F>(fn));
+        source->chain(task([from, fx]() mutable {
+            if (from->_error) fx(from->_error);
+        }), target);
+    }
+    
+private:
+    future(const future&) = delete;
+    future& operator = (const future&) = delete;
+    
+    template<typename U> friend struct future;
+    template<typename U> friend struct promise;
+    template<typename U> friend future<typename std::conditional<std::is_void<U>::value, void, std::vector<U>>::type> when_all(std::vector<future<U>>& futures);
+    template<typename U> friend future<typename std::conditional<std::is_void<U>::value, size_t, std::pair<size_t, U>>::type> when_any(std::vector<future<U>>& futures);
+    
+    std::shared_ptr<state_t> _state;
+};
+
+//for promise
+//_______________________________________________________________________________________________________________
+template<typename T>
+struct promise {
+    promise(void) : _state(std::make_shared<future_state<T>>()), _taken(false) {}
+    promise(promise&& b) : _state(std::move(b._state)), _taken(b._taken) {}
+    ~promise(void) {
+        if (_state && !_state->ready()) {
+            _state->setError(std::make_exception_ptr(std::runtime_error("broken promise")));
+        }
+    }
+    
+    /*one future per promise*/
+    future<T>   getFuture(void) {
+        future<T> f;
+        if (!_state || _taken) {
+            log_error("illegal call!");
+            return f;
+        }
+        _taken = true;
+        f._state = _state;
+        return f;
+    }
+    
+    template<typename... Params>
+    bool    setValue(Params&&... params) {
+        return _state && _state->setValue(std::forward<Params>(params)...);
+    }
+    bool    setError(std::exception_ptr error) {
+        return _state && _state->setError(error);
+    }
+    
+private:
+    promise(const promise&) = delete;
+    promise& operator = (const promise&) = delete;
+    
+    std::shared_ptr<future_state<T>> _state;
+    bool    _taken;
+};
+
+//for calls
+//_______________________________________________________________________________________________________________
+template<typename R>
+struct future_call {
+    template<typename F>
+    static void apply(F& fn, promise<R>& p) { p.setValue(fn()); }
+};
+
+template<>
+struct future_call<void> {
+    template<typename F>
+    static void apply(F& fn, promise<void>& p) { fn(); p.setValue(); }
+};
+
+/*run fn on target, its result or exception settles the future, so does a push refused by the queue limit of target*/
+template<typename F, typename R = typename future_result<F, void>::type>
+future<R>   call(runnable* target, F&& fn) {
+    std::shared_ptr<promise<R>> p = std::make_shared<promise<R>>();
+    future<R> f = p->getFuture();
+    typename std::decay<F>::type fx(std::forward<F>(fn));
+    if (runnable::push(task([p, fx]() mutable {
+        try {
+            future_call<R>::apply(fx, *p);
+        }
+        catch (...) {
+            p->setError(std::current_exception());
+        }
+    }), 0, 1, target) == runnable::invalid_task_id) {
+        p->setError(std::make_exception_ptr(std::runtime_error("runnable overloaded!")));
+    }
+    return f;
+}
+
+template<typename F, typename R = typename future_result<F, void>::type>
+future<R>   call(std::shared_ptr<runnable> target, F&& fn) {
+    return call(target.get(), std::forward<F>(fn));
+}
+
+//for scatter-gather
+//_______________________________________________________________________________________________________________
+template<typename T>
+struct when_all_cxt {
+    typedef typename std::conditional<std::is_void<T>::value, void, std::vector<T>>::type result_t;
+    
+    promise<result_t>   _result;
+    std::vector<std::shared_ptr<future_state<T>>> _states;
+    std::atomic<size_t> _left;
+    std::atomic<bool>   _done;
+    
+    when_all_cxt(size_t count) : _left(count), _done(false) {}
+    
+    void settled(future_state<T>& one) {
+        if (one._error) {
+            if (!_done.exchange(true)) _result.setError(one._error);
+        }
+        else if (_left.fetch_sub(1, std::memory_order_acq_rel) == 1 && !_done.exchange(true)) {
+            collect();
+        }
+        //states may be released only after all settled, they hold the continuations back to us
+    }
+    void collect(void) {
+        collect(std::is_void<T>());
+    }
+    
+private:
+    void collect(std::true_type) {
+        _result.setValue();
+    }
+    void collect(std::false_type) {
+        result_t values;
+        values.reserve(_states.size());
+        for (size_t i = 0; i < _states.size(); i++) {
+            values.push_back(std::move(_states[i]->value()));
+        }
+        _result.setValue(std::move(values));
+    }
+};
+
+/*settled with all values in order, or the first error. futures are consumed, continuations run on the settling threads*/
+template<typename T>
+future<typename std::conditional<std::is_void<T>::value, void, std::vector<T>>::type> when_all(std::vector<future<T>>& futures) {
+    typedef when_all_cxt<T> cxt_t;
+    std::shared_ptr<cxt_t> cxt = std::make_shared<cxt_t>(futures.size());
+    future<typename cxt_t::result_t> f = cxt->_result.getFuture();
+    if (futures.empty()) {
+        cxt->collect();
+        return f;
+    }
+    for (size_t i = 0; i < futures.size(); i++) {
+        if (!futures[i]._state) {
+            log_error("illegal argment!");
+            cxt->_result.setError(std::make_exception_ptr(std::invalid_argument("invalid future")));
+            return f;
+        }
+        cxt->_states.push_back(std::move(futures[i]._state));
+    }
+    for (size_t i = 0; i < cxt->_states.size(); i++) {
+        future_state<T>* one = cxt->_states[i].get();
+        one->chain(task([cxt, one]() {
+            cxt->settled(*one);
+        }), nullptr);
+    }
+    futures.clear();
+    return f;
+}
+
+template<typename T>
+struct when_any_cxt {
+    typedef typename std::conditional<std::is_void<T>::value, size_t, std::pair<size_t, T>>::type result_t;
+    
+    promise<result_t>   _result;
+    std::atomic<bool>   _done;
+    
+    when_any_cxt(void) : _done(false) {}
+    
+    void settled(size_t index, future_state<T>& one) {
+        if (_done.exchange(true)) {
+            return;
+        }
+        if (one._error) {
+            _result.setError(one._error);
+        }
+        else {
+            settle(index, one, std::is_void<T>());
+        }
+    }
+    
+private:
+    void settle(size_t index, future_state<T>& one, std::true_type) {
+        _result.setValue(index);
+    }
+    void settle(size_t index, future_state<T>& one, std::false_type) {
+        _result.setValue(index, std::move(one.value()));
+    }
+};
+
+/*settled by the first one settled, with its index and value, or its error*/
+template<typename T>
+future<typename std::conditional<std::is_void<T>::value, size_t, std::pair<size_t, T>>::type> when_any(std::vector<future<T>>& futures) {
+    typedef when_any_cxt<T> cxt_t;
+    std::shared_ptr<cxt_t> cxt = std::make_shared<cxt_t>();
+    future<typename cxt_t::result_t> f = cxt->_result.getFuture();
+    if (futures.empty()) {
+        log_error("illegal argment!");
+        cxt->_result.setError(std::make_exception_ptr(std::invalid_argument("no future")));
+        return f;
+    }
+    for (size_t i = 0; i < futures.size(); i++) {
+        std::shared_ptr<future_state<T>> one = std::move(futures[i]._state);
+        if (!one) {
+            continue;
+        }
+        future_state<T>* source = one.get();
+        source->chain(task([cxt, one, i]() {
+            cxt->settled(i, *one);
+        }), nullptr);
+    }
+    futures.clear();
+    return f;
+}
+
+_TS_NAMESPACE_END
+
+#endif /*_TS_FUTURE_INC_*/
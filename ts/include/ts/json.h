@@ -20,6 +20,7 @@
 #define _TS_JSON_INC_
 #pragma once
 
+#include <functional>
 #include <ts/pie.h>
 
 _TS_NAMESPACE_BEGIN
@@ -33,6 +34,9 @@ namespace json {
     std::string&    format(const ts::pie& js, std::string& out, bool quot = false, bool align = false);
 
     bool            fromFile(ts::pie& out, const char* file, std::string& err);
+    /*read and parsed on the io side of ts::file, cb runs on the calling runnable*/
+    typedef std::function<void(bool ok, ts::pie& out, std::string& err)> loaded_t;
+    void            fromFileAsync(const char* file, loaded_t cb);
     long            toFile(const ts::pie& js, const char* file, bool quot = false, bool align = false);
 
     //tool set, skip '\n','\r','\t',' ', line comment(//) and comment block(/**/)
@@ -24,6 +24,7 @@
 #include <ts/asyn.h>
 #include <queue>
 #include <string>
+#include <vector>
 
 _TS_NAMESPACE_BEGIN
 
@@ -83,12 +84,15 @@ namespace net {
         
         //return _size_queuing, return -1 if an error occurs
         virtual const int   send(std::shared_ptr<std::string>& packet);
+        //on the runnable it lives on, an accepted one is dropped by its server, which calls onConnectionClose later
         void                close(void);
         int                 queuingSize(void) const {return _size_queuing;}
         
         const address_t&    local(void) const {return _local;}
         const address_t&    peer(void) const {return _local;}
         const int           id(void) const {return _fd;}
+        /*runnable it lives on, send must be called there, nullptr if unknown*/
+        virtual runnable*   host(void) const {return nullptr;}
         
         void                setStreamer(std::shared_ptr<connection_io> st) {_streamer = st;}
         std::shared_ptr<connection_io>&  getStreamer(void) {return _streamer;}
@@ -119,9 +123,16 @@ namespace net {
     //
     //______________________________________________________________________
     struct server : public runnable::listener, parasite {
+        typedef enum {ROUND_ROBIN = 0, LEAST_CONNECTIONS} balance_t;
+        
         explicit server(runnable const& host, uint16_t concurrent = 128);
-        ~server(void);
+        //returns after host and workers have dropped it, from any thread.
+        //derived callbacks are gone by then, so close it first if connections may still be dispatched
+        virtual ~server(void);
         
+        //TCP only, accepted connections are handed over to workers, their io and callbacks run there,
+        //the host only accepts. must be called before bind
+        bool    setWorkers(const std::vector<std::shared_ptr<runnable>>& workers, balance_t balance = ROUND_ROBIN);
         bool    bind(const address_t& local, bool portReuse = false);
         bool    close(void);
         int     id(void) const __attr_threading("unsafe");
@@ -152,6 +163,33 @@ namespace net {
         struct server_cxt*  _cxt;
     };
     
+    //multi-reactor server, N runnables own a server each, all bound to the same address with SO_REUSEPORT,
+    //the kernel spreads connections (datagrams for UDP) among them, no state is shared between reactors
+    //______________________________________________________________________
+    struct server_group {
+        /*create a server on the host, called on the host thread*/
+        typedef std::function<server*(runnable const& host)> factory_t;
+        
+        explicit server_group(factory_t factory, size_t count = 0 /*0 for one per core*/, bool pin = true /*pin reactor i to core i*/);
+        ~server_group(void);
+        
+        //bind all reactors, return false if any of them failed, port must be specified
+        bool    start(const address_t& local);
+        //close and delete all servers, reactors keep running
+        void    stop(void);
+        
+        size_t      size(void) const;
+        runnable&   host(size_t index) const;
+        server*     get(size_t index) const;
+        
+    private:
+        server_group(const server_group&) = delete;
+        server_group& operator = (const server_group&) = delete;
+        
+    protected:
+        struct server_group_cxt*  _cxt;
+    };
+    
     //TCP only connector
     //______________________________________________________________________
     struct connector : public runnable::listener, parasite {
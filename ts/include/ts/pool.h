@@ -0,0 +1,75 @@
+/* ====================================================================
+ * Copyright (c) 2018-2022 The TS Project.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ====================================================================
+ */
+#if !defined(_TS_POOL_INC_)
+#define _TS_POOL_INC_
+#pragma once
+
+#include <ts/tss.h>
+#include <ts/asyn.h>
+
+_TS_NAMESPACE_BEGIN
+
+/*work-stealing thread pool, every worker owns a Chase-Lev deque,
+ tasks submitted by a worker go to its own deque, the others go to a shared injection queue.
+ idle workers spin a little, then park; workers above the minimum quit after being idle for keepalive.
+ */
+struct pool {
+    struct stats_t {
+        size_t      threads;    //workers alive
+        size_t      idle;       //workers parked
+        size_t      queued;     //tasks waiting to run
+        size_t      peak;       //high-water mark of queued
+        uint64_t    submitted;
+        uint64_t    executed;
+        uint64_t    stolen;     //tasks taken from the deque of another worker
+    };
+
+    /**
+     @name          - thread name of workers
+     @minThreads    - workers kept alive even if idle
+     @maxThreads    - upper limit of workers, 0 for one per core
+     @keepalive     - idle miliseconds before a worker above minThreads quits
+     */
+    explicit pool(const char* name = "tsPool", size_t minThreads = 1, size_t maxThreads = 0, int64_t keepalive = 3000);
+    ~pool(void); //queued tasks are run out before it returns, the ones racing with it by the calling thread
+
+    bool        submit(task&& ta);
+
+    /*change limits at runtime, maxThreads is bounded by the one passed to constructor*/
+    void        limit(size_t minThreads, size_t maxThreads);
+    /*pin workers, alive ones are moved before running their next task*/
+    void        setPlacement(const runnable::placement_t& place);
+    stats_t     stats(void) const;
+
+    /*the pool behind runnable::background and ts::slide*/
+    static pool&    shared(void);
+
+private:
+    pool(const pool&) = delete;
+    pool& operator = (const pool&) = delete;
+
+    void    work(struct pool_worker* worker);
+
+private:
+    struct pool_cxt*    _cxt;
+};
+
+_TS_NAMESPACE_END
+
+#endif /*_TS_POOL_INC_*/
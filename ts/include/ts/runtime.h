@@ -0,0 +1,71 @@
+/* ====================================================================
+ * Copyright (c) 2018-2022 The TS Project.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ====================================================================
+ */
+#if !defined(_TS_RUNTIME_INC_)
+#define _TS_RUNTIME_INC_
+#pragma once
+
+#include <ts/tss.h>
+#include <ts/asyn.h>
+#include <ts/pool.h>
+
+_TS_NAMESPACE_BEGIN
+
+/*a group of runnables, one per core and pinned to it,
+ background tasks of a runnable go to a pool kept on the same numa node.
+ cores are given as a cpu list like "0-3,8,10-11", the format of /sys/devices/system/cpu/online,
+ so placement can be tuned along with irq affinity from configuration.
+ */
+struct runtime {
+    /**
+     @name  - name of the group, threads of runnables and background workers are named after it
+     @cores - cpu list to run on, one runnable per core, nullptr for all online cores
+     @pin   - pin runnable i to the i-th core, and background workers to the numa node of it
+     */
+    explicit runtime(const char* name = "tsRuntime", const char* cores = nullptr, bool pin = true);
+    ~runtime(void); //stop and join all runnables
+    
+    const char* name(void) const;
+    size_t      size(void) const;
+    std::shared_ptr<runnable>   get(size_t index) const;
+    std::shared_ptr<runnable>   next(void); //round robin, to spread connections or sessions
+    size_t      core(size_t index) const;   //core of runnable index
+    /*background pool on the numa node of runnable index*/
+    pool&       background(size_t index);
+    
+public:
+    static size_t   cores(void);            //online cores
+    static size_t   nodes(void);            //numa nodes, 1 if not numa
+    static int      node(size_t core);      //numa node of core, 0 if not numa
+    static std::vector<size_t>  coresOf(int node);
+    /*parse cpu list like "0-3,8,10-11", return empty if illegal*/
+    static std::vector<size_t>  parse(const char* list);
+    /*pin calling thread, empty placement for all cores*/
+    static bool     pin(const runnable::placement_t& place);
+    
+private:
+    runtime(const runtime&) = delete;
+    runtime& operator = (const runtime&) = delete;
+    
+private:
+    struct runtime_cxt* _cxt;
+};
+
+_TS_NAMESPACE_END
+
+#endif /*_TS_RUNTIME_INC_*/
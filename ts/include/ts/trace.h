@@ -0,0 +1,71 @@
+/* ====================================================================
+ * Copyright (c) 2018-2022 The TS Project.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ====================================================================
+ */
+#if !defined(_TS_TRACE_INC_)
+#define _TS_TRACE_INC_
+#pragma once
+
+#include <ts/tss.h>
+#include <ts/asyn.h>
+#include <atomic>
+#include <string>
+
+_TS_NAMESPACE_BEGIN
+
+/*timeline of runnables in chrome trace format(chrome://tracing, ui.perfetto.dev).
+ events are kept in a ring per thread, the oldest ones are overwritten, recording takes no lock.
+ a push is linked to its run by a flow arrow, so the queueing delay between them shows up across runnables.
+ 
+    ts::trace::start();
+    ...
+    ts::trace::toFile("/tmp/ts.trace.json");
+ */
+struct trace {
+    typedef enum {
+        EVENT_PUSH = 0, //task pushed to the runnable of the same thread
+        EVENT_POST,     //task pushed to another runnable
+        EVENT_DEQUEUE,  //task taken from the queue by the loop
+        EVENT_RUN,      //task invoked
+        EVENT_TIMER,    //delayed or repeated task fired
+        EVENT_RECV,     //listener onRecv
+        EVENT_WRITABLE, //listener onWritable
+        EVENT_CLOSE,    //listener onClose
+    } event_t;
+    
+    /*start recording, capacity is events kept per thread*/
+    static void     start(size_t capacity = 65536);
+    static void     stop(void);
+    static void     clear(void);
+    static inline bool  enabled(void) { return _enabled.load(std::memory_order_relaxed); }
+    
+    /*chrome trace json of events recorded, by ts::json::format*/
+    static std::string& dump(std::string& out);
+    static long     toFile(const char* file);
+    
+    //for instrumentation
+    static int64_t  now(void); //in nanoseconds, monotonic
+    /*scope and id identify a task, owner and type are of its callable or listener*/
+    static void     record(event_t kind, const void* scope, int64_t id, int64_t begin, int64_t end, const std::type_info* type, const void* owner, int fd = -1);
+    
+private:
+    static std::atomic<bool>    _enabled;
+};
+
+_TS_NAMESPACE_END
+
+#endif /*_TS_TRACE_INC_*/
@@ -20,6 +20,7 @@
 #define _TS_XML_INC_
 #pragma once
 
+#include <functional>
 #include <ts/pie.h>
 
 _TS_NAMESPACE_BEGIN
@@ -29,6 +30,9 @@ namespace xml {
     std::string&    format(const ts::pie& js, std::string& out, bool prop_tag = false);
     
     bool            fromFile(ts::pie& out, const char* file, std::string& err, const char* tags_excluding = "script,style");
+    /*read and parsed on the io side of ts::file, cb runs on the calling runnable*/
+    typedef std::function<void(bool ok, ts::pie& out, std::string& err)> loaded_t;
+    void            fromFileAsync(const char* file, loaded_t cb, const char* tags_excluding = "script,style");
     long            toFile(const ts::pie& js, const char* file);
 };
 
@@ -3,23 +3,39 @@
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <string>
 #include <thread>
 #include <tuple>
 #include <chrono>
-#include <list>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <algorithm>
 #include <ts/asyn.h>
+#include <ts/pool.h>
+#include <ts/runtime.h>
+#include <ts/trace.h>
 #include <ts/json.h>
 #include <ts/log.h>
+#if defined(__GNUG__)
+# include <cxxabi.h>
+#endif
 #if defined(__APPLE__) || defined(__MACH__)
 # include <mach/mach_time.h>
 #endif
+#if defined(_OS_LINUX_)
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <sys/syscall.h>
+#endif
 
 _TS_NAMESPACE_USING
 _TS_NAMESPACE_BEGIN
 
-typedef std::map<int, std::pair<ts::runnable::listener*, bool>>    mapListener;
+typedef std::unordered_map<int, std::pair<ts::runnable::listener*, bool>>    mapListener;
 typedef std::map<uint64_t, void*> mapKeyValue;
 typedef runnable::task_id   task_id_t;
 
@@ -41,25 +57,46 @@ void renameThread(const char* name) {
 
 //for time
 //_______________________________________________________________________________________________________________
-int64_t getUptimeInMilliseconds(void) {
+int64_t getUptimeInMicroseconds(void) {
 #if defined(_WIN32) || defined(_WIN64)
-    return GetTickCount();
-#elif (defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__))
+    return (int64_t)GetTickCount() * 1000LL;
+#elif defined(_OS_LINUX_) || (defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__))
     struct timespec t;
     t.tv_sec = t.tv_nsec = 0;
     clock_gettime(CLOCK_MONOTONIC, &t);
-    return (int64_t)(t.tv_sec)*1000LL + (t.tv_nsec/1000000);
+    return (int64_t)(t.tv_sec)*1000000LL + (t.tv_nsec/1000);
 #elif defined(__APPLE__) || defined(__MACH__)
     static mach_timebase_info_data_t s_timebase_info;
     if (s_timebase_info.denom == 0) {
         (void) mach_timebase_info(&s_timebase_info);
     }
     // mach_absolute_time() returns billionth of seconds,
-    // so divide by one million to get milliseconds
-    return (int64_t)((mach_absolute_time() * s_timebase_info.numer) / (1000000 * s_timebase_info.denom));
+    // so divide by one thousand to get microseconds
+    return (int64_t)((mach_absolute_time() * s_timebase_info.numer) / (1000 * s_timebase_info.denom));
 #endif
 }
 
+int64_t getUptimeInNanoseconds(void) {
+#if defined(_WIN32) || defined(_WIN64)
+    return (int64_t)GetTickCount() * 1000000LL;
+#elif defined(_OS_LINUX_) || (defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__))
+    struct timespec t;
+    t.tv_sec = t.tv_nsec = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)(t.tv_sec)*1000000000LL + t.tv_nsec;
+#elif defined(__APPLE__) || defined(__MACH__)
+    static mach_timebase_info_data_t s_timebase_info;
+    if (s_timebase_info.denom == 0) {
+        (void) mach_timebase_info(&s_timebase_info);
+    }
+    return (int64_t)((mach_absolute_time() * s_timebase_info.numer) / s_timebase_info.denom);
+#endif
+}
+
+int64_t getUptimeInMilliseconds(void) {
+    return getUptimeInMicroseconds() / 1000;
+}
+
 uint64_t getThreadId(void) {
     pthread_t tid = pthread_self();
     uint64_t thread_id = 0;
@@ -79,21 +116,38 @@ static inline bool fd_isvalid(int fd) {
 struct listAction {
     struct action_t {
         enum {trap,push,cancel,listen,unlisten,markWritable} mode;
-        std::shared_ptr<runnable::bind_base_t> call;
+        task        call;
+        void*       owner;      /*for cancel by owner and listen*/
         task_id_t   id; //or fd
-        int64_t     period;     /*period value in milliseconds*/
-        int64_t     timeout;    /*timeout value in milliseconds*/
+        int64_t     period;     /*period value in microseconds*/
+        int64_t     timeout;    /*timeout value in microseconds*/
         int64_t     count;      /*loop count*/
         bool        consumed;
+        bool        urgent;     /*in urgent lane*/
+        bool        counted;    /*in the depth of queue limit*/
+        size_t      slot;       /*position in heapAction*/
         action_t*   prev;
         action_t*   next;
-        static action_t* zero(void) { return new action_t{trap, nullptr, runnable::invalid_task_id, 0, 0, 0, false, nullptr, nullptr};}
+        action_t*   oprev;      /*siblings of the same owner, for mapOwner*/
+        action_t*   onext;
+        std::atomic<action_t*>  link;   /*for queueAction*/
+        action_t(void) : mode(trap), owner(nullptr), id(runnable::invalid_task_id), period(0), timeout(0), count(0), consumed(false), urgent(false), counted(false), slot((size_t)-1), prev(nullptr), next(nullptr), oprev(nullptr), onext(nullptr), link(nullptr) {}
+        
+        //back to the state of a new one, call has been released already
+        void reuse(void) {
+            mode = trap; owner = nullptr; id = runnable::invalid_task_id;
+            period = timeout = count = 0;
+            consumed = urgent = counted = false; slot = (size_t)-1;
+            prev = next = nullptr;
+            oprev = onext = nullptr;
+            link.store(nullptr, std::memory_order_relaxed);
+        }
     };
     
     action_t    _head;
     action_t*   _tail;
     
-    listAction(void) : _head{action_t::trap, nullptr, runnable::invalid_task_id, 0, 0, 0} {_tail = &_head;}
+    listAction(void) {_tail = &_head;}
     ~listAction(void) {
         clear();
     }
@@ -109,123 +163,1049 @@ struct listAction {
         _tail = &_head;
     }
     
+    void addToTail(action_t* one) {
+        _tail->next = one;
+        one->prev = _tail;
+        one->next = nullptr;
+        _tail = one;
+    }
+    
+    void unlink(action_t* one) {
+        if (&_head == one) return;
+        if (one == _tail) _tail = one->prev;
+        one->prev->next = one->next;
+        if (one->next) {
+            one->next->prev = one->prev;
+        }
+    }
+};
+
+//intrusive multi-producer single-consumer queue(Dmitry Vyukov), push is wait-free and pop never locks
+struct queueAction {
+    typedef listAction::action_t action_t;
+
+    std::atomic<action_t*>  _tail;  /*producers side*/
+    action_t*   _head;              /*consumer side*/
+    action_t    _stub;
+
+    queueAction(void) : _tail(&_stub), _head(&_stub) {}
+    ~queueAction(void) {
+        clear();
+    }
+
+    //called by consumer only, a push in progress is treated as non-empty
+    bool empty(void) const {
+        return _head == &_stub && _tail.load(std::memory_order_relaxed) == &_stub;
+    }
+
+    //called by consumer only
+    void clear(void) {
+        action_t* one = nullptr;
+        while ((one = pop()) != nullptr) {
+            delete one;
+        }
+    }
+
+    void push(action_t* one) {
+        push(one, one);
+    }
+
+    //a chain linked by link already, published at once
+    void push(action_t* first, action_t* last) {
+        last->link.store(nullptr, std::memory_order_relaxed);
+        action_t* prev = _tail.exchange(last, std::memory_order_acq_rel);
+        prev->link.store(first, std::memory_order_release);
+    }
+
+    //return nullptr if queue is empty or a producer is just in the middle of push, it will signal later
+    action_t* pop(void) {
+        action_t* head = _head;
+        action_t* next = head->link.load(std::memory_order_acquire);
+        if (head == &_stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            _head = head = next;
+            next = next->link.load(std::memory_order_acquire);
+        }
+        if (next) {
+            _head = next;
+            return head;
+        }
+        if (head != _tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        push(&_stub);
+        next = head->link.load(std::memory_order_acquire);
+        if (next) {
+            _head = next;
+            return head;
+        }
+        return nullptr;
+    }
+};
+
+//4-ary min heap ordered by (timeout, id), each action keeps its own slot for O(log n) erase and re-arm
+struct heapAction {
+    typedef listAction::action_t action_t;
+    static constexpr size_t npos = (size_t)-1;
+
+    std::vector<action_t*>  _nodes;
+
+    ~heapAction(void) {
+        clear();
+    }
+
+    void clear(void) {
+        for (size_t i = 0; i < _nodes.size(); i++) {
+            delete _nodes[i];
+        }
+        _nodes.clear();
+    }
+
+    inline size_t size(void) const {return _nodes.size();}
+    inline action_t* top(void) const {return _nodes.size() ? _nodes[0] : nullptr;}
+
     void insert(action_t* one) {
-        if (_head.next) {
-            action_t* it = _head.next;
-            while (it) {
-                if (it->timeout > one->timeout) {
-                    it->prev->next = one;
-                    one->prev = it->prev;
-                    one->next = it;
-                    it->prev = one;
+        one->slot = _nodes.size();
+        _nodes.push_back(one);
+        up(one->slot);
+    }
+
+    //detach from heap without deleting it
+    void erase(action_t* one) {
+        size_t i = one->slot;
+        action_t* last = _nodes.back();
+        _nodes.pop_back();
+        one->slot = npos;
+        if (last != one) {
+            _nodes[i] = last;
+            last->slot = i;
+            update(i);
+        }
+    }
+
+    //call it after the timeout of the node in slot i has been changed
+    void update(size_t i) {
+        if (i > 0 && less(_nodes[i], _nodes[(i - 1) >> 2])) {
+            up(i);
+        }
+        else {
+            down(i);
+        }
+    }
+
+private:
+    static inline bool less(const action_t* a, const action_t* b) {
+        return a->timeout < b->timeout || (a->timeout == b->timeout && a->id < b->id);
+    }
+    inline void place(size_t i, action_t* one) {
+        _nodes[i] = one;
+        one->slot = i;
+    }
+    void up(size_t i) {
+        action_t* one = _nodes[i];
+        while (i > 0) {
+            size_t parent = (i - 1) >> 2;
+            if (!less(one, _nodes[parent])) break;
+            place(i, _nodes[parent]);
+            i = parent;
+        }
+        place(i, one);
+    }
+    void down(size_t i) {
+        action_t* one = _nodes[i];
+        size_t n = _nodes.size();
+        for (;;) {
+            size_t first = (i << 2) + 1;
+            if (first >= n) break;
+            size_t best = first, last = std::min(first + 4, n);
+            for (size_t c = first + 1; c < last; c++) {
+                if (less(_nodes[c], _nodes[best])) best = c;
+            }
+            if (!less(_nodes[best], one)) break;
+            place(i, _nodes[best]);
+            i = best;
+        }
+        place(i, one);
+    }
+};
+
+//open addressing table from task id to pending action, no allocation once it has grown up
+struct mapHandle {
+    typedef listAction::action_t action_t;
+    struct slot_t {
+        task_id_t   id;
+        action_t*   one;
+    };
+
+    std::vector<slot_t> _slots;
+    size_t              _size;
+
+    mapHandle(void) : _slots(64, slot_t{runnable::invalid_task_id, nullptr}), _size(0) {}
+
+    void clear(void) {
+        std::fill(_slots.begin(), _slots.end(), slot_t{runnable::invalid_task_id, nullptr});
+        _size = 0;
+    }
+
+    void insert(task_id_t id, action_t* one) {
+        if ((_size + 1) * 4 > _slots.size() * 3) {
+            grow();
+        }
+        size_t i = home(id);
+        while (_slots[i].id != runnable::invalid_task_id) {
+            i = (i + 1) & mask();
+        }
+        _slots[i] = slot_t{id, one};
+        _size++;
+    }
+
+    action_t* find(task_id_t id) const {
+        for (size_t i = home(id); _slots[i].id != runnable::invalid_task_id; i = (i + 1) & mask()) {
+            if (_slots[i].id == id) return _slots[i].one;
+        }
+        return nullptr;
+    }
+
+    void erase(task_id_t id) {
+        size_t i = home(id);
+        for (; _slots[i].id != id; i = (i + 1) & mask()) {
+            if (_slots[i].id == runnable::invalid_task_id) return;
+        }
+        //backward shift deletion, keeps probe chains intact without tombstones
+        for (size_t j = (i + 1) & mask(); _slots[j].id != runnable::invalid_task_id; j = (j + 1) & mask()) {
+            size_t k = home(_slots[j].id);
+            if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+            _slots[i] = _slots[j];
+            i = j;
+        }
+        _slots[i] = slot_t{runnable::invalid_task_id, nullptr};
+        _size--;
+    }
+
+private:
+    inline size_t mask(void) const {return _slots.size() - 1;}
+    inline size_t home(task_id_t id) const {
+        uint64_t h = (uint64_t)id * 0x9E3779B97F4A7C15ULL;
+        return (size_t)(h ^ (h >> 32)) & mask();
+    }
+    void grow(void) {
+        std::vector<slot_t> old(_slots.size() * 2, slot_t{runnable::invalid_task_id, nullptr});
+        old.swap(_slots);
+        _size = 0;
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i].id != runnable::invalid_task_id) insert(old[i].id, old[i].one);
+        }
+    }
+};
+
+//pending tasks and listening fds by owner, so cancelOwner costs what the owner has only
+struct mapOwner {
+    typedef listAction::action_t action_t;
+    struct entry_t {
+        action_t*   tasks;  /*linked by oprev/onext*/
+        std::unordered_set<int> fds;
+        entry_t(void) : tasks(nullptr) {}
+    };
+    typedef std::unordered_map<void*, entry_t> map_t;
+    
+    map_t   _entries;
+    
+    entry_t* find(void* owner) {
+        map_t::iterator it = _entries.find(owner);
+        return it == _entries.end() ? nullptr : &it->second;
+    }
+    
+    void drop(void* owner, entry_t& en) {
+        if (en.tasks == nullptr && en.fds.empty()) {
+            _entries.erase(owner);
+        }
+    }
+    
+    void insert(action_t* one) {
+        if (one->owner == nullptr) return;
+        entry_t& en = _entries[one->owner];
+        one->oprev = nullptr;
+        one->onext = en.tasks;
+        if (en.tasks) en.tasks->oprev = one;
+        en.tasks = one;
+    }
+    
+    void erase(action_t* one) {
+        if (one->owner == nullptr) return;
+        if (one->onext) one->onext->oprev = one->oprev;
+        if (one->oprev) {
+            one->oprev->onext = one->onext;
+        }
+        else {//head
+            entry_t* en = find(one->owner);
+            if (en && en->tasks == one) {
+                en->tasks = one->onext;
+                drop(one->owner, *en);
+            }
+        }
+        one->oprev = one->onext = nullptr;
+    }
+    
+    void insert(void* owner, int fd) {
+        _entries[owner].fds.insert(fd);
+    }
+    
+    void erase(void* owner, int fd) {
+        entry_t* en = find(owner);
+        if (en) {
+            en->fds.erase(fd);
+            drop(owner, *en);
+        }
+    }
+    
+    void clear(void) {
+        _entries.clear();
+    }
+};
+
+//recycled action nodes of a runnable, the free list is touched by the loop thread only
+struct poolAction {
+    typedef listAction::action_t action_t;
+    static constexpr size_t max_free = 4096; /*the rest goes back to global allocator*/
+    
+    action_t*   _free;
+    size_t      _size;
+    std::atomic<uint64_t>   _allocated; /*nodes from global allocator*/
+    std::atomic<uint64_t>   _recycled;  /*nodes from free list*/
+    
+    poolAction(void) : _free(nullptr), _size(0), _allocated(0), _recycled(0) {}
+    ~poolAction(void) {
+        while (_free) {
+            action_t* one = _free;
+            _free = one->next;
+            delete one;
+        }
+    }
+    
+    //local is true if called by the loop thread
+    action_t* acquire(bool local) {
+        if (local && _free) {
+            action_t* one = _free;
+            _free = one->next;
+            _size--;
+            one->reuse();
+            _recycled.store(_recycled.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return one;
+        }
+        _allocated.fetch_add(1, std::memory_order_relaxed);
+        return new action_t();
+    }
+    
+    //called by the loop thread only
+    void release(action_t* one) {
+        one->call.reset();
+        if (_size >= max_free) {
+            delete one;
+            return;
+        }
+        one->next = _free;
+        _free = one;
+        _size++;
+    }
+};
+
+//for poller
+//_______________________________________________________________________________________________________________
+struct poller {
+    struct event_t {
+        int     fd;
+        bool    readable;
+        bool    writable;
+        bool    broken;     /*fd is not valid any more*/
+    };
+    static constexpr int max_events = 256;
+
+    virtual ~poller(void) {}
+    /*registrations are persistent until removed*/
+    virtual bool    add(int fd, bool writable) = 0;
+    virtual bool    modify(int fd, bool writable) = 0;
+    virtual void    remove(int fd) = 0;
+    /*wait at most microseconds (-1 for infinite), return count of events, return -1 if an error occurs*/
+    virtual int     wait(int64_t microseconds, event_t* events, int max) = 0;
+
+    static poller*  create(runnable::poller_t type);
+};
+
+struct select_poller : public poller {
+    std::map<int, bool> _fds; /*fd and writable*/
+
+    bool add(int fd, bool writable) {
+        if (fd >= FD_SETSIZE) {
+            log_error("fd[%d] is out of FD_SETSIZE!", fd);
+            return false;
+        }
+        _fds[fd] = writable;
+        return true;
+    }
+    bool modify(int fd, bool writable) {
+        std::map<int, bool>::iterator it = _fds.find(fd);
+        if (it == _fds.end()) {
+            return false;
+        }
+        it->second = writable;
+        return true;
+    }
+    void remove(int fd) {
+        _fds.erase(fd);
+    }
+    int wait(int64_t microseconds, event_t* events, int max) {
+        fd_set    fdrset, fdwset, fdeset;
+#if defined(__APPLE__)
+        typedef __darwin_time_t __second_t;
+        typedef __darwin_suseconds_t  __suseconds_t;
+#else
+        typedef time_t __second_t;
+        typedef long  __suseconds_t;
+#endif
+        struct    timeval to = {static_cast<__second_t>(microseconds / 1000000), static_cast<__suseconds_t>(microseconds % 1000000)};
+
+        FD_ZERO(&fdrset);
+        FD_ZERO(&fdwset);
+        FD_ZERO(&fdeset);
+
+        int fd = 0;
+        for (std::map<int, bool>::iterator it = _fds.begin(); it != _fds.end(); it++) {
+            FD_SET(it->first, &fdrset);
+            FD_SET(it->first, &fdeset);
+            if (it->second) {
+                FD_SET(it->first, &fdwset);
+            }
+        }
+        if (_fds.size()) {
+            fd = (--_fds.end())->first;
+        }
+
+        int r = select((int)fd + 1, &fdrset, &fdwset, &fdeset, microseconds < 0 ? nullptr : &to);
+        int n = 0;
+        if (r == -1) {
+            if (EBADF != errno && ERANGE != errno) {
+                return -1;
+            }
+            for (std::map<int, bool>::iterator it = _fds.begin(); it != _fds.end() && n < max; ) {
+                if (!fd_isvalid(it->first)) { //except
+                    events[n++] = event_t{it->first, false, false, true};
+#if __cplusplus > 199711L
+                    it = _fds.erase(it);
+#else
+                    _fds.erase(it++);
+#endif
+                }
+                else {
+                    ++it;
+                }
+            }
+            return n;
+        }
+        for (std::map<int, bool>::iterator it = _fds.begin(); r > 0 && it != _fds.end() && n < max; it++) {
+            bool readable = FD_ISSET(it->first, &fdrset), writable = FD_ISSET(it->first, &fdwset);
+            if (readable || writable) {
+                events[n++] = event_t{it->first, readable, writable, false};
+            }
+        }
+        return n;
+    }
+};
+
+#if defined(_OS_LINUX_)
+struct epoll_poller : public poller {
+    int     _epfd;
+    bool    _pwait2;
+
+    epoll_poller(int epfd) : _epfd(epfd), _pwait2(true) {}
+    ~epoll_poller(void) {
+        close(_epfd);
+    }
+
+    bool add(int fd, bool writable) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | (writable ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.fd = fd;
+        if (epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev) == 0) {
+            return true;
+        }
+        if (errno == EEXIST) {//fd reused before being unlistened
+            return epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == 0;
+        }
+        log_error("failed to add fd[%d] to epoll, err=%s", fd, strerror(errno));
+        return false;
+    }
+    bool modify(int fd, bool writable) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | (writable ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.fd = fd;
+        if (epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == 0) {
+            return true;
+        }
+        if (errno == ENOENT) {//closed and reopened under the same number
+            return epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+        }
+        return false;
+    }
+    void remove(int fd) {
+        struct epoll_event ev = {0, {0}};
+        epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, &ev); //closed fd has been removed by kernel aready
+    }
+    int wait(int64_t microseconds, event_t* events, int max) {
+        struct epoll_event evs[poller::max_events];
+        max = std::min(max, (int)poller::max_events);
+        int r = -1;
+#if defined(__NR_epoll_pwait2)
+        if (_pwait2) {//microsecond resolution since linux 5.11
+            struct timespec ts = {(time_t)(microseconds / 1000000), (long)(microseconds % 1000000) * 1000};
+            r = (int)syscall(__NR_epoll_pwait2, _epfd, evs, max, microseconds < 0 ? nullptr : &ts, nullptr, 0);
+            if (r < 0 && errno == ENOSYS) {
+                _pwait2 = false;
+            }
+        }
+        if (!_pwait2)
+#endif
+        r = epoll_wait(_epfd, evs, max, microseconds < 0 ? -1 : (int)((microseconds + 999) / 1000));
+        if (r < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+        for (int i = 0; i < r; i++) {
+            //hangup and error are delivered as readable, the same as select does
+            events[i] = event_t{evs[i].data.fd, (evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0, (evs[i].events & EPOLLOUT) != 0, false};
+        }
+        return r;
+    }
+};
+#endif
+
+poller* poller::create(runnable::poller_t type) {
+#if defined(_OS_LINUX_)
+    if (type != runnable::POLLER_SELECT) {
+        int epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd != -1) {
+            return new epoll_poller(epfd);
+        }
+        log_warning("failed to create epoll, err=%s, fallback to select!", strerror(errno));
+    }
+#endif
+    return new select_poller();
+}
+
+//for runnable bridge
+//_______________________________________________________________________________________________________________
+struct batch_cxt {
+    struct runnable_bridge* _bridge;
+    listAction::action_t*   _first;
+    listAction::action_t*   _last;
+    size_t      _size;
+    batch_cxt*  _prev;  /*outer batch of this thread*/
+};
+
+static thread_local batch_cxt*  _local_batch = nullptr;
+
+struct runnable_bridge {
+    std::unique_ptr<std::thread> _thread;
+    uint64_t    _creator;
+    uint64_t    _self;
+    const char* _name;
+    bool        _running;
+    bool        _going;
+    bool        _reset;
+    int         _signals[2]; /*read and write, the same eventfd on linux*/
+    std::atomic<bool>       _sleeping;  /*loop is parked in poller, producers have to wake it up*/
+    std::atomic<task_id_t>  _idNext;
+    mapListener _listeners;
+    mapKeyValue _keyValues;
+    queueAction _waitings;  /*shared with producers*/
+    listAction  _urgents;   /*latency critical, run first and out of budget*/
+    listAction  _realtimes; /*bulk lane*/
+    std::atomic<size_t>     _budgetTasks;   /*tasks run per iteration before polling io, 0 for no limit*/
+    std::atomic<int64_t>    _budgetTime;    /*in microseconds, 0 for no limit*/
+    std::atomic<int64_t>    _spinMax;   /*busy-poll window limit in microseconds, 0 for off*/
+    int64_t     _spinWindow;    /*current busy-poll window, adapted to the idle gaps*/
+    int64_t     _idleGap;       /*moving average of idle gaps, 8 times of microseconds*/
+    std::atomic<uint64_t>   _parks;
+    std::atomic<uint64_t>   _spinHits;
+    std::atomic<uint64_t>   _spinMisses;
+    std::atomic<uint64_t>   _spinTime;
+    listAction::action_t    _mark;      /*end of current realtime round*/
+    listAction::action_t*   _current;   /*delayed action being invoked*/
+    heapAction  _delays;
+    mapHandle   _handles;   /*pending push actions by task id*/
+    mapOwner    _owners;
+    poolAction  _pool;
+    runnable::placement_t   _placement; /*guarded by _lock*/
+    std::atomic<pool*>      _background;/*nullptr for pool::shared()*/
+    std::atomic<int64_t>    _slowTask;  /*in microseconds, 0 for off*/
+    std::atomic<int64_t>    _watchdog;  /*in miliseconds, 0 for off*/
+    bool        _watched;   /*either of above or tracing, refreshed per iteration*/
+    std::atomic<int64_t>    _busySince; /*when current iteration started in microseconds, 0 while polling*/
+    int64_t     _flagged;   /*_busySince reported by watchdog already, touched by watchdog only*/
+    std::atomic<const std::type_info*>  _inflight;  /*type of the callback being invoked*/
+    std::atomic<void*>      _inflightOwner;
+    std::atomic<uint64_t>   _slowTasks;
+    std::atomic<uint64_t>   _stalls;
+    std::atomic<uint64_t>   _enqueued;  /*bulk tasks pushed, by producers*/
+    std::atomic<uint64_t>   _dequeued;  /*bulk tasks run, canceled or dropped, by loop*/
+    std::atomic<uint64_t>   _queuePeak;
+    std::atomic<size_t>     _capacity;  /*limit of bulk tasks waiting, 0 for no limit*/
+    std::atomic<int>        _overload;  /*runnable::overload_t*/
+    std::atomic<int64_t>    _blockTimeout;  /*in miliseconds*/
+    std::atomic<int>        _blocked;   /*producers waiting for room*/
+    std::atomic<bool>       _overloaded;/*rejected since last time under the limit, for logging once*/
+    std::atomic<uint64_t>   _rejected;
+    std::atomic<uint64_t>   _dropped;
+    std::mutex              _roomLock;
+    std::condition_variable _room;
+    std::unique_ptr<poller> _poller;
+    std::mutex  _lock;
+
+    runnable_bridge(const char* name) : _creator(getThreadId()), _self(0), _name(name), _running(false), _going(true), _reset(false), _signals{-1,-1}, _sleeping(false), _idNext(0), _budgetTasks(1024), _budgetTime(2000), _spinMax(0), _spinWindow(0), _idleGap(0), _parks(0), _spinHits(0), _spinMisses(0), _spinTime(0), _current(nullptr), _background(nullptr), _slowTask(0), _watchdog(0), _watched(false), _busySince(0), _flagged(0), _inflight(nullptr), _inflightOwner(nullptr), _slowTasks(0), _stalls(0), _enqueued(0), _dequeued(0), _queuePeak(0), _capacity(0), _overload(runnable::OVERLOAD_NONE), _blockTimeout(0), _blocked(0), _overloaded(false), _rejected(0), _dropped(0) {}
+
+    void notify(void) {
+        if (_signals[0] == _signals[1]) {//eventfd
+            uint64_t one = 1;
+            write(_signals[1], &one, sizeof(one));
+        }
+        else {
+            write(_signals[1], "X", 1);
+        }
+    }
+
+    //loop thread only, a relaxed increment without the lock prefix
+    static void count(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    //the idle gap is from running out of work to the next work found, the window covers most of the gaps,
+    //spinning is given up while the gaps are typically longer than the limit, they are still sampled when parked
+    void adapt(int64_t gap) {
+        int64_t limit = _spinMax.load(std::memory_order_relaxed);
+        _idleGap += gap - _idleGap / 8;
+        int64_t average = _idleGap / 8;
+        _spinWindow = average * 2 + 1;
+        if (_spinWindow > limit) {
+            _spinWindow = average > limit ? 0 : limit;
+        }
+    }
+
+    //pairs with the fence in loop, only the first producer after the loop parked pays for the syscall
+    void wakeup(void) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleeping.load(std::memory_order_relaxed) && _sleeping.exchange(false)) {
+            notify();
+        }
+    }
+
+    //the loop thread applies its own actions directly, no queue and no wakeup,
+    //the others are held by the batch of calling thread if any
+    void commit(listAction::action_t* one, bool local) {
+        if (local) {
+            apply(one);
+        }
+        else if (_local_batch && _local_batch->_bridge == this) {
+            batch_cxt* ba = _local_batch;
+            one->link.store(nullptr, std::memory_order_relaxed);
+            if (ba->_last) {
+                ba->_last->link.store(one, std::memory_order_relaxed);
+            }
+            else {
+                ba->_first = one;
+            }
+            ba->_last = one;
+            ba->_size++;
+        }
+        else {
+            _waitings.push(one);
+            wakeup();
+        }
+    }
+
+    inline listAction& lane(listAction::action_t* one) {
+        return one->urgent ? _urgents : _realtimes;
+    }
+
+    //timestamp callbacks in nanoseconds while watched, the watchdog reads what is in flight
+    inline int64_t enter(const std::type_info& type, void* owner) {
+        _inflightOwner.store(owner, std::memory_order_relaxed);
+        _inflight.store(&type, std::memory_order_release);
+        return getUptimeInNanoseconds();
+    }
+    void leave(int64_t begin, trace::event_t kind, int64_t id, int fd);
+    
+    inline void invoke(listAction::action_t* one) {
+        if (!_watched) {
+            one->call();
+            return;
+        }
+        int64_t begin = enter(one->call.type(), one->owner);
+        one->call();
+        leave(begin, one->period ? trace::EVENT_TIMER : trace::EVENT_RUN, one->id, -1);
+    }
+    
+    //bulk tasks waiting to run, both counters only grow
+    inline size_t depth(void) const {
+        int64_t n = (int64_t)(_enqueued.load(std::memory_order_relaxed) - _dequeued.load(std::memory_order_relaxed));
+        return n > 0 ? (size_t)n : 0;
+    }
+    
+    inline void enqueued(void) {
+        uint64_t n = _enqueued.fetch_add(1, std::memory_order_relaxed) + 1 - _dequeued.load(std::memory_order_relaxed);
+        uint64_t peak = _queuePeak.load(std::memory_order_relaxed);
+        while ((int64_t)n > (int64_t)peak && !_queuePeak.compare_exchange_weak(peak, n, std::memory_order_relaxed));
+    }
+    
+    inline void release(listAction::action_t* one) {
+        if (one->counted) {
+            _dequeued.store(_dequeued.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        _pool.release(one);
+    }
+    
+    bool admit(bool local);
+    void shed(size_t capacity);
+    void room(void);
+    
+    void apply(listAction::action_t* one);
+    size_t run(listAction& lane, size_t budget, int64_t deadline);
+};
+
+//producer side of the queue limit, the limit is soft, concurrent producers may pass it by a few
+bool runnable_bridge::admit(bool local) {
+    size_t capacity = _capacity.load(std::memory_order_relaxed);
+    if (capacity == 0 || depth() < capacity) {
+        return true;
+    }
+    int policy = _overload.load(std::memory_order_relaxed);
+    if (policy == runnable::OVERLOAD_NONE || policy == runnable::OVERLOAD_DROP_OLDEST) {//loop sheds
+        return true;
+    }
+    if (policy == runnable::OVERLOAD_BLOCK && !local) {//never block the loop itself
+        int64_t timeout = _blockTimeout.load(std::memory_order_relaxed);
+        std::unique_lock<std::mutex> _auto_lock(_roomLock);
+        _blocked.fetch_add(1, std::memory_order_seq_cst); /*pairs with the fence in room*/
+        bool ok = _room.wait_for(_auto_lock, std::chrono::milliseconds(timeout), [this, capacity]() {
+            return depth() < capacity;
+        });
+        _blocked.fetch_sub(1, std::memory_order_relaxed);
+        if (ok) {
+            return true;
+        }
+    }
+    _rejected.fetch_add(1, std::memory_order_relaxed);
+    if (!_overloaded.exchange(true, std::memory_order_relaxed)) {
+        log_warning("runnable %s overloaded, %d tasks queued!", _name, (int)depth());
+    }
+    return false;
+}
+
+//drop the oldest bulk tasks over the limit
+void runnable_bridge::shed(size_t capacity) {
+    listAction::action_t* next = _realtimes._head.next;
+    while (depth() > capacity && next) {
+        listAction::action_t* one = next;
+        next = one->next;
+        if (!one->counted) {//continuations and fired timers are out of the limit
+            continue;
+        }
+        _realtimes.unlink(one);
+        _handles.erase(one->id);
+        _owners.erase(one);
+        release(one);
+        _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+//once per iteration, wake up blocked producers if there is room
+void runnable_bridge::room(void) {
+    size_t capacity = _capacity.load(std::memory_order_relaxed);
+    if (capacity == 0 || depth() >= capacity) {
+        return;
+    }
+    if (depth() < capacity / 2) {
+        _overloaded.store(false, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_blocked.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> _auto_lock(_roomLock);
+        _room.notify_all();
+    }
+}
+
+static std::string demangle(const std::type_info* type) {
+    if (type == nullptr) {
+        return "unknown";
+    }
+#if defined(__GNUG__)
+    int status = 0;
+    char* name = abi::__cxa_demangle(type->name(), nullptr, nullptr, &status);
+    if (name) {
+        std::string r(name);
+        free(name);
+        return r;
+    }
+#endif
+    return type->name();
+}
+
+void runnable_bridge::leave(int64_t begin, trace::event_t kind, int64_t id, int fd) {
+    const std::type_info* type = _inflight.load(std::memory_order_relaxed);
+    _inflight.store(nullptr, std::memory_order_relaxed);
+    int64_t end = getUptimeInNanoseconds();
+    if (trace::enabled()) {
+        trace::record(kind, this, id, begin, end, type, _inflightOwner.load(std::memory_order_relaxed), fd);
+    }
+    int64_t limit = _slowTask.load(std::memory_order_relaxed);
+    if (limit == 0) {
+        return;
+    }
+    int64_t took = (end - begin) / 1000;
+    if (took <= limit) {
+        return;
+    }
+    _slowTasks.store(_slowTasks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (fd < 0) {
+        log_warning("slow task on %s: %lld us, owner %p, %s!", _name, (long long)took, _inflightOwner.load(std::memory_order_relaxed), demangle(type).c_str());
+    }
+    else {
+        log_warning("slow listener on %s: %lld us, fd %d, %s!", _name, (long long)took, fd, demangle(type).c_str());
+    }
+}
+
+//one thread watching all runnables which have a watchdog, it wakes up at a quarter of the shortest limit
+//_______________________________________________________________________________________________________________
+struct watchdog {
+    std::mutex  _lock;
+    std::condition_variable _cond;
+    std::unordered_set<runnable_bridge*>    _bridges;
+    std::unique_ptr<std::thread>    _thread;
+    
+    static watchdog& shared(void) {
+        static watchdog* s_watchdog = new watchdog(); /*never destroyed, runnables may be destroyed while exiting*/
+        return *s_watchdog;
+    }
+    
+    void add(runnable_bridge* bridge) {
+        std::lock_guard<std::mutex> _auto_lock(_lock);
+        _bridges.insert(bridge);
+        if (!_thread) {
+            _thread.reset(new std::thread(&watchdog::run, this));
+            _thread->detach();
+        }
+        _cond.notify_one();
+    }
+    
+    void remove(runnable_bridge* bridge) {
+        std::lock_guard<std::mutex> _auto_lock(_lock);
+        _bridges.erase(bridge);
+    }
+    
+    void run(void) {
+        renameThread("tsWatchdog");
+        std::unique_lock<std::mutex> _auto_lock(_lock);
+        for (;;) {
+            int64_t period = 1000; /*in miliseconds*/
+            int64_t now = getUptimeInMicroseconds();
+            for (std::unordered_set<runnable_bridge*>::iterator it = _bridges.begin(); it != _bridges.end(); it++) {
+                runnable_bridge* bridge = *it;
+                int64_t limit = bridge->_watchdog.load(std::memory_order_relaxed);
+                if (limit == 0) {
+                    continue;
+                }
+                period = std::min(period, std::max<int64_t>(limit / 4, 1));
+                int64_t since = bridge->_busySince.load(std::memory_order_relaxed);
+                if (since == 0 || since == bridge->_flagged || now - since <= limit * 1000) {
+                    continue;
+                }
+                bridge->_flagged = since; /*once per iteration*/
+                bridge->_stalls.fetch_add(1, std::memory_order_relaxed);
+                const std::type_info* type = bridge->_inflight.load(std::memory_order_acquire);
+                log_error("runnable %s stalled for %lld ms, in %s, owner %p!", bridge->_name, (long long)(now - since) / 1000, demangle(type).c_str(), bridge->_inflightOwner.load(std::memory_order_relaxed));
+            }
+            _cond.wait_for(_auto_lock, std::chrono::milliseconds(period));
+        }
+    }
+};
+
+//run a round of lane, tasks pushed meanwhile wait for next round, return budget left
+size_t runnable_bridge::run(listAction& lane, size_t budget, int64_t deadline) {
+    if (lane._head.next == nullptr) {
+        return budget;
+    }
+    lane.addToTail(&_mark);
+    size_t ran = 0;
+    for (;;) {
+        listAction::action_t* one = lane._head.next;
+        if (one == &_mark) {
+            lane.unlink(one);
+            break;
+        }
+        if (ran == budget || (deadline && (ran & 15) == 15 && getUptimeInMicroseconds() >= deadline)) {//out of budget, the rest wait for next iteration
+            lane.unlink(&_mark);
+            break;
+        }
+        lane.unlink(one);
+        _handles.erase(one->id);
+        _owners.erase(one);
+        invoke(one);
+        release(one);
+        ran++;
+    }
+    return budget - ran;
+}
+
+void runnable_bridge::apply(listAction::action_t* one) {
+    switch (one->mode) {
+        case listAction::action_t::push: {
+            _handles.insert(one->id, one);
+            _owners.insert(one);
+            if (one->period) { //delay
+                _delays.insert(one);
+            }
+            else {
+                lane(one).addToTail(one);
+            }
+        } break;
+            
+        case listAction::action_t::cancel : {
+            if (one->id != runnable::invalid_task_id) {//by id
+                listAction::action_t* it = _handles.find(one->id);
+                if (it) {
+                    _handles.erase(it->id);
+                    if (it == _current) {//cancel itself, dropped after invoking
+                        it->consumed = true;
+                    }
+                    else if (it->slot != heapAction::npos) {
+                        _delays.erase(it);
+                        _owners.erase(it);
+                        release(it);
+                    }
+                    else {
+                        lane(it).unlink(it);
+                        _owners.erase(it);
+                        release(it);
+                    }
+                }
+            }
+            else if (one->owner) {//by owner
+                void* own = one->owner;
+                mapOwner::entry_t* en = _owners.find(own);
+                if (en == nullptr) {
+                    release(one);
                     break;
                 }
-                it = it->next;
+                {//tasks of the owner
+                    listAction::action_t* it = en->tasks;
+                    while (it) {
+                        listAction::action_t* next = it->onext;
+                        if (it == _current) {//cancel itself, dropped after invoking
+                            if (!it->consumed) _handles.erase(it->id);
+                            it->consumed = true;
+                        }
+                        else {
+                            _handles.erase(it->id);
+                            if (it->slot != heapAction::npos) {
+                                _delays.erase(it);
+                            }
+                            else {
+                                lane(it).unlink(it);
+                            }
+                            _owners.erase(it);
+                            release(it);
+                        }
+                        it = next;
+                    }
+                }
+                en = _owners.find(own); /*may be dropped with its last task*/
+                if (en) {//listeners of the owner
+                    std::unordered_set<int> fds;
+                    fds.swap(en->fds);
+                    _owners.drop(own, *en);
+                    for (std::unordered_set<int>::iterator it = fds.begin(); it != fds.end(); it++) {
+                        _poller->remove(*it);
+                        close(*it);
+                        _listeners.erase(*it);
+                    }
+                }
+            }
+            else {
+                //error
+                log_error("logic error");
+            }
+            release(one);
+        } break;
+            
+        case listAction::action_t::listen : {
+            if (_poller->add((int)one->id, false)) {
+                mapListener::iterator it = _listeners.find((int)one->id);
+                if (it != _listeners.end() && (void*)it->second.first != one->owner) {//fd reused, the old owner must not close it any more
+                    _owners.erase(it->second.first, it->first);
+                }
+                _listeners[(int)one->id] = std::make_pair(reinterpret_cast<runnable::listener*>(one->owner), false);
+                _owners.insert(one->owner, (int)one->id);
             }
-            if (it == nullptr) {//add to tail
-                _tail->next = one;
-                one->prev = _tail;
-                one->next = nullptr;
-                _tail = one;
+            release(one);
+        } break;
+            
+        case listAction::action_t::unlisten : {
+            mapListener::iterator it = _listeners.find((int)one->id);
+            if (it != _listeners.end()) {
+                _poller->remove(it->first);
+                _owners.erase(it->second.first, it->first);
+                _listeners.erase(it);
             }
-        }
-        else {
-            _head.next = one;
-            one->prev = &_head;
-            one->next = nullptr;
-            _tail = one;
-        }
-    }
-    
-    void addToTail(action_t* one) {
-        _tail->next = one;
-        one->prev = _tail;
-        one->next = nullptr;
-        _tail = one;
-    }
-    
-    void remove(action_t* one) {
-        if (&_head == one) return;
-        if (one == _tail) _tail = one->prev;
-        one->prev->next = one->next;
-        if (one->next) {
-            one->next->prev = one->prev;
-        }
-        delete one;
-    }
-    
-    void moveToTail(action_t* one) {
-        if (&_head == one) return;
-        action_t* pos = one;
-        action_t* next = one->next;
-        while (next) {
-            if (next->timeout > one->timeout) {
-                break;
+            release(one);
+        } break;
+
+        case listAction::action_t::markWritable : {
+            mapListener::iterator it = _listeners.find((int)one->id);
+            if (it != _listeners.end() && it->second.second != (one->count ? true : false)) {
+                it->second.second = one->count ? true : false;
+                if (!_poller->modify(it->first, it->second.second)) {//fd has been closed
+                    runnable::listener* lis = it->second.first;
+                    _owners.erase(lis, it->first);
+                    _listeners.erase(it);
+                    lis->onClose((int)one->id);
+                }
             }
-            pos = next;
-            next = next->next;
-        }
-        if (pos != one) {
-            one->prev->next = one->next;
-            one->next->prev = one->prev;
+            release(one);
+        } break;
             
-            if (pos->next) pos->next->prev = one;
-            one->next = pos->next;
-            pos->next = one;
-            one->prev = pos;
-        }
-        if (one->next == nullptr) _tail = one;
+        default: {
+            release(one);
+        } break;
     }
-};
-
-struct bind_owner_t : public runnable::bind_base_t {
-    std::shared_ptr<life> _life;
-    void* _owner;
-    void invoke(void) {}
-    void* owner(void) {return _owner;}
-};
-
-//for runnable bridge
-//_______________________________________________________________________________________________________________
-struct runnable_bridge {
-    std::unique_ptr<std::thread> _thread;
-    uint64_t    _creator;
-    uint64_t    _self;
-    const char* _name;
-    bool        _running;
-    bool        _going;
-    bool        _reset;
-    int         _signals[2]; /*read and write*/
-    task_id_t   _idNext;
-    mapListener _listeners;
-    mapKeyValue _keyValues;
-    listAction* _waitings;  /*critical area*/
-    listAction  _waitings_cache[2];   /*critical area*/
-    listAction  _realtimes;
-    listAction  _delays;
-    std::mutex  _lock;
-};
-
-runnable::runnable(const char* name) : _bridge(new runnable_bridge{nullptr, getThreadId(), 0, name, false, true, false, {-1,-1}, 0, mapListener(), mapKeyValue()}) {
-    _bridge->_waitings_cache[0].addToTail(listAction::action_t::zero());
-    _bridge->_waitings_cache[1].addToTail(listAction::action_t::zero());
-    _bridge->_waitings = &_bridge->_waitings_cache[0];
+}
 
-    if (pipe(_bridge->_signals) == -1) {
-        log_notice("failed to create pipe!");
-        throw std::runtime_error("failed to create pipe!");
-    }
-    else {
+runnable::runnable(const char* name, poller_t type) : _bridge(new runnable_bridge(name)) {
+#if defined(_OS_LINUX_)
+    _bridge->_signals[0] = _bridge->_signals[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    if (_bridge->_signals[0] == -1) {//fallback to pipe
+        if (pipe(_bridge->_signals) == -1) {
+            log_notice("failed to create pipe!");
+            throw std::runtime_error("failed to create pipe!");
+        }
         int flags = fcntl(_bridge->_signals[0], F_GETFL, 0);
         fcntl(_bridge->_signals[0], F_SETFL, flags | O_NONBLOCK);
         flags = fcntl(_bridge->_signals[1], F_GETFL, 0);
         fcntl(_bridge->_signals[1], F_SETFL, flags | O_NONBLOCK);
     }
+
+    _bridge->_poller.reset(poller::create(type));
+    _bridge->_poller->add(_bridge->_signals[0], false);
 }
 
 runnable::~runnable(void) {
+    if (_bridge->_watchdog.load(std::memory_order_relaxed)) {
+        watchdog::shared().remove(_bridge.get());
+    }
+    _bridge->_poller.reset();
     close(_bridge->_signals[0]);
-    close(_bridge->_signals[1]);
+    if (_bridge->_signals[1] != _bridge->_signals[0]) {
+        close(_bridge->_signals[1]);
+    }
 }
 
 //static functions
@@ -234,6 +1214,19 @@ runnable*    runnable::current(void) {
 }
 
 task_id_t   runnable::push(std::shared_ptr<runnable::bind_base_t> ca, int64_t miliseconds, int64_t count, runnable* target) {
+    return push_us(ca, miliseconds * 1000, count, target);
+}
+
+task_id_t   runnable::push(task&& ta, int64_t miliseconds, int64_t count, runnable* target, lane_t lane) {
+    return push_us(std::move(ta), miliseconds * 1000, count, target, lane);
+}
+
+task_id_t   runnable::push_us(std::shared_ptr<runnable::bind_base_t> ca, int64_t microseconds, int64_t count, runnable* target) {
+    void* owner = ca ? ca->owner() : nullptr;
+    return push_us(task([ca]() {ca->invoke();}, owner), microseconds, count, target);
+}
+
+task_id_t   runnable::push_us(task&& ta, int64_t microseconds, int64_t count, runnable* target, lane_t lane) {
     if (count == 0) {
         log_error("illegal argment!");
         return runnable::invalid_task_id;
@@ -245,17 +1238,31 @@ task_id_t   runnable::push(std::shared_ptr<runnable::bind_base_t> ca, int64_t mi
     }
 
     runnable_bridge* bridge = target->_bridge.get();
-    std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
+    bool bulk = lane == LANE_BULK && microseconds == 0;
+    if (bulk && !bridge->admit(target == _local_this)) {
+        return runnable::invalid_task_id;
+    }
+    listAction::action_t* one = bridge->_pool.acquire(target == _local_this);
+    if (bulk) {
+        one->counted = true;
+        bridge->enqueued();
+    }
 
-    bridge->_waitings->_tail->mode   = listAction::action_t::push;
-    bridge->_waitings->_tail->call   = ca;
-    bridge->_waitings->_tail->period = miliseconds;
-    bridge->_waitings->_tail->count  = count;
-    bridge->_waitings->_tail->timeout= getUptimeInMilliseconds() + miliseconds;
-    task_id id = bridge->_idNext++;
-    bridge->_waitings->_tail->id     = id;
+    one->mode   = listAction::action_t::push;
+    one->owner  = ta.owner();
+    one->call   = std::move(ta);
+    one->period = microseconds;
+    one->count  = count;
+    one->urgent = lane == LANE_URGENT;
+    one->timeout= getUptimeInMicroseconds() + microseconds;
+    task_id id  = bridge->_idNext.fetch_add(1, std::memory_order_relaxed);
+    one->id     = id;
+    if (trace::enabled()) {
+        int64_t now = trace::now();
+        trace::record(target == _local_this ? trace::EVENT_PUSH : trace::EVENT_POST, bridge, id, now, now, &one->call.type(), one->owner);
+    }
     
-    target->expansion_commit();
+    bridge->commit(one, target == _local_this);
     
     return id;
 }
@@ -272,12 +1279,12 @@ void     runnable::cancel(task_id id, runnable* target) {
     }
 
     runnable_bridge* bridge = target->_bridge.get();
-    std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
+    listAction::action_t* one = bridge->_pool.acquire(target == _local_this);
     
-    bridge->_waitings->_tail->mode   = listAction::action_t::cancel;
-    bridge->_waitings->_tail->id     = id;
+    one->mode   = listAction::action_t::cancel;
+    one->id     = id;
     
-    target->expansion_commit();
+    bridge->commit(one, target == _local_this);
 }
 
 void     runnable::cancelOwner(void* owner, runnable* target) {
@@ -291,17 +1298,14 @@ void     runnable::cancelOwner(void* owner, runnable* target) {
         return;
     }
     
-    bind_owner_t* bind = new bind_owner_t();
-    bind->_owner = owner;
-
     runnable_bridge* bridge = target->_bridge.get();
-    std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
+    listAction::action_t* one = bridge->_pool.acquire(target == _local_this);
     
-    bridge->_waitings->_tail->mode   = listAction::action_t::cancel;
-    bridge->_waitings->_tail->call   = std::shared_ptr<runnable::bind_base_t>(bind);
-    bridge->_waitings->_tail->id     = runnable::invalid_task_id;
+    one->mode   = listAction::action_t::cancel;
+    one->owner  = owner;
+    one->id     = runnable::invalid_task_id;
     
-    target->expansion_commit();
+    bridge->commit(one, target == _local_this);
 }
 
 void     runnable::addListener(listener* lis, int fd, const runnable* target) {
@@ -315,18 +1319,14 @@ void     runnable::addListener(listener* lis, int fd, const runnable* target) {
         return;
     }
     
-    bind_owner_t* bind = new bind_owner_t();
-    bind->_life = nullptr;
-    bind->_owner= lis;
-
     runnable_bridge* bridge = target->_bridge.get();
-    std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
+    listAction::action_t* one = bridge->_pool.acquire(target == _local_this);
     
-    bridge->_waitings->_tail->mode  = listAction::action_t::listen;
-    bridge->_waitings->_tail->call  = std::shared_ptr<runnable::bind_base_t>(bind);
-    bridge->_waitings->_tail->id    = fd;
-
-    const_cast<runnable*>(target)->expansion_commit();
+    one->mode   = listAction::action_t::listen;
+    one->owner  = lis;
+    one->id     = fd;
+    
+    bridge->commit(one, target == _local_this);
 }
 
 void     runnable::removeListener(int fd, const runnable* target) {
@@ -340,18 +1340,13 @@ void     runnable::removeListener(int fd, const runnable* target) {
         return;
     }
     
-    bind_owner_t* bind = new bind_owner_t();
-    bind->_life = nullptr;
-    bind->_owner= nullptr;
-    
     runnable_bridge* bridge = target->_bridge.get();
-    std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
+    listAction::action_t* one = bridge->_pool.acquire(target == _local_this);
     
-    bridge->_waitings->_tail->mode  = listAction::action_t::unlisten;
-    bridge->_waitings->_tail->call  = std::shared_ptr<runnable::bind_base_t>(bind);
-    bridge->_waitings->_tail->id    = fd;
+    one->mode   = listAction::action_t::unlisten;
+    one->id     = fd;
     
-    const_cast<runnable*>(target)->expansion_commit();
+    bridge->commit(one, target == _local_this);
 }
 
 void     runnable::wantWritable(int fd, bool want, const runnable* target) {
@@ -366,13 +1361,59 @@ void     runnable::wantWritable(int fd, bool want, const runnable* target) {
     }
     
     runnable_bridge* bridge = target->_bridge.get();
-    std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
+    listAction::action_t* one = bridge->_pool.acquire(target == _local_this);
     
-    bridge->_waitings->_tail->mode   = listAction::action_t::markWritable;
-    bridge->_waitings->_tail->id     = fd;
-    bridge->_waitings->_tail->count  = want;
+    one->mode   = listAction::action_t::markWritable;
+    one->id     = fd;
+    one->count  = want;
     
-    const_cast<runnable*>(target)->expansion_commit();
+    bridge->commit(one, false); /*deferred, a failed modify reports onClose to the listener*/
+}
+
+void     runnable::pushBatch(std::vector<task>& tasks, int64_t miliseconds, runnable* target) {
+    if (target == nullptr) target = _local_this;
+    if (target == nullptr) {
+        log_error("not valid runnable object found!");
+        return;
+    }
+    batch ba(target);
+    for (size_t i = 0; i < tasks.size(); i++) {
+        push(std::move(tasks[i]), miliseconds, 1, target);
+    }
+}
+
+//for batch
+//_______________________________________________________________________________________________________________
+runnable::batch::batch(runnable* target) : _cxt(new batch_cxt()) {
+    if (target == nullptr) target = _local_this;
+    _cxt->_bridge = target ? target->_bridge.get() : nullptr;
+    _cxt->_first = _cxt->_last = nullptr;
+    _cxt->_size = 0;
+    _cxt->_prev = _local_batch;
+    _local_batch = _cxt;
+}
+
+runnable::batch::~batch(void) {
+    commit();
+    if (_local_batch == _cxt) {
+        _local_batch = _cxt->_prev;
+    }
+    delete _cxt;
+}
+
+void    runnable::batch::commit(void) {
+    if (_cxt->_first == nullptr) {
+        return;
+    }
+    runnable_bridge* bridge = _cxt->_bridge;
+    bridge->_waitings.push(_cxt->_first, _cxt->_last);
+    _cxt->_first = _cxt->_last = nullptr;
+    _cxt->_size = 0;
+    bridge->wakeup();
+}
+
+size_t  runnable::batch::size(void) const {
+    return _cxt->_size;
 }
 
 bool    runnable::setValue(uint64_t key, void* value) {
@@ -422,7 +1463,7 @@ std::unique_ptr<std::thread>    runnable::stop(void) {
     }
     std::unique_ptr<std::thread> r(_bridge->_thread.release());
     bridge->_going = false;
-    write(bridge->_signals[1], "X", 1);
+    bridge->notify();
     return r;
 }
 
@@ -430,7 +1471,7 @@ void    runnable::reset(void) {
     runnable_bridge* bridge = _bridge.get();
     std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
     bridge->_reset = true;
-    write(bridge->_signals[1], "X", 1);
+    bridge->notify();
 }
 
 void    runnable::join(void) {
@@ -456,9 +1497,91 @@ bool    runnable::verify(bool log) const {
     return true;
 }
 
-void    runnable::expansion_commit(void) {
-    _bridge->_waitings->addToTail(listAction::action_t::zero());
-    write(_bridge->_signals[1], "X", 1);
+void    runnable::setBudget(size_t tasks, int64_t microseconds) {
+    runnable_bridge* bridge = _bridge.get();
+    bridge->_budgetTasks.store(tasks, std::memory_order_relaxed);
+    bridge->_budgetTime.store(microseconds, std::memory_order_relaxed);
+}
+
+void    runnable::setBusyPoll(int64_t microseconds) {
+    runnable_bridge* bridge = _bridge.get();
+    if (microseconds < 0) {
+        log_warning("illegal argment!");
+        microseconds = 0;
+    }
+    bridge->_spinMax.store(microseconds, std::memory_order_relaxed);
+}
+
+void    runnable::setPlacement(const placement_t& place) {
+    runnable_bridge* bridge = _bridge.get();
+    std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
+    bridge->_placement = place;
+    if (bridge->_running && bridge->_self) {//pinned by the loop thread itself
+        push(task([place]() {
+            runtime::pin(place);
+        }, this), 0, 1, this, LANE_URGENT);
+    }
+}
+
+void    runnable::setQueueLimit(size_t capacity, overload_t policy, int64_t timeout) {
+    runnable_bridge* bridge = _bridge.get();
+    if (timeout < 0) {
+        log_warning("illegal argment!");
+        timeout = 0;
+    }
+    bridge->_overload.store(policy, std::memory_order_relaxed);
+    bridge->_blockTimeout.store(timeout, std::memory_order_relaxed);
+    bridge->_capacity.store(capacity, std::memory_order_relaxed);
+}
+
+void    runnable::setSlowTask(int64_t microseconds) {
+    if (microseconds < 0) {
+        log_warning("illegal argment!");
+        microseconds = 0;
+    }
+    _bridge->_slowTask.store(microseconds, std::memory_order_relaxed);
+}
+
+void    runnable::setWatchdog(int64_t miliseconds) {
+    if (miliseconds < 0) {
+        log_warning("illegal argment!");
+        miliseconds = 0;
+    }
+    int64_t old = _bridge->_watchdog.exchange(miliseconds, std::memory_order_relaxed);
+    if (old == 0 && miliseconds) {
+        watchdog::shared().add(_bridge.get());
+    }
+    else if (old && miliseconds == 0) {
+        watchdog::shared().remove(_bridge.get());
+    }
+}
+
+void    runnable::setBackground(pool* target) {
+    _bridge->_background.store(target, std::memory_order_release);
+}
+
+runnable::placement_t   runnable::placement(void) const {
+    runnable_bridge* bridge = _bridge.get();
+    std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
+    return bridge->_placement;
+}
+
+runnable::stats_t   runnable::stats(void) const {
+    runnable_bridge* bridge = _bridge.get();
+    stats_t st;
+    st.allocated= bridge->_pool._allocated.load(std::memory_order_relaxed);
+    st.recycled = bridge->_pool._recycled.load(std::memory_order_relaxed);
+    st.parks    = bridge->_parks.load(std::memory_order_relaxed);
+    st.spinHits = bridge->_spinHits.load(std::memory_order_relaxed);
+    st.spinMisses = bridge->_spinMisses.load(std::memory_order_relaxed);
+    st.spinTime = bridge->_spinTime.load(std::memory_order_relaxed);
+    st.slowTasks= bridge->_slowTasks.load(std::memory_order_relaxed);
+    st.stalls   = bridge->_stalls.load(std::memory_order_relaxed);
+    st.queued   = bridge->depth();
+    st.queuePeak= bridge->_queuePeak.load(std::memory_order_relaxed);
+    st.rejected = bridge->_rejected.load(std::memory_order_relaxed);
+    st.dropped  = bridge->_dropped.load(std::memory_order_relaxed);
+    return st;
 }
 
 void    runnable::loop_join(void) {
@@ -468,6 +1591,9 @@ void    runnable::loop_join(void) {
         _local_this = this;
         renameThread(bridge->_name);
         bridge->_self = getThreadId();
+        if (!bridge->_placement.empty()) {
+            runtime::pin(bridge->_placement);
+        }
     }
     
     loop();
@@ -486,341 +1612,220 @@ void    runnable::loop(void) {
         if (bridge->_reset) {
             std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
             bridge->_reset = false;
-            bridge->_waitings->clear();
-            bridge->_waitings->addToTail(listAction::action_t::zero());
+            bridge->_waitings.clear();
+            bridge->_urgents.clear();
             bridge->_realtimes.clear();
             bridge->_delays.clear();
+            bridge->_handles.clear();
+            for (mapListener::iterator it = bridge->_listeners.begin(); it != bridge->_listeners.end(); it++) {
+                bridge->_poller->remove(it->first);
+            }
             bridge->_listeners.clear();
+            bridge->_owners.clear();
+            bridge->_dequeued.store(bridge->_enqueued.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        bridge->_watched = bridge->_slowTask.load(std::memory_order_relaxed) || bridge->_watchdog.load(std::memory_order_relaxed) || trace::enabled();
+        int64_t timeout = excute();
+        if (timeout == 0) {
+            wait(0);
+            continue;
+        }
+        int64_t idle = 0;
+        if (bridge->_spinMax.load(std::memory_order_relaxed)) {//busy-poll
+            idle = getUptimeInMicroseconds();
+            if (spin(idle, timeout)) {
+                continue;
+            }
+        }
+        //park, unless something has been pushed since excute
+        bridge->_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!bridge->_waitings.empty()) {
+            timeout = 0;
+        }
+        else {
+            runnable_bridge::count(bridge->_parks);
+        }
+        wait(timeout);
+        bridge->_sleeping.store(false, std::memory_order_relaxed);
+        if (idle) {
+            bridge->adapt(getUptimeInMicroseconds() - idle);
         }
-        int64_t ms = excute();
-        wait(ms ? ms : 1000);
     }
 }
 
-int64_t runnable::excute(void) {
+bool    runnable::spin(int64_t idle, int64_t timeout) {
     runnable_bridge* bridge = _bridge.get();
-    {//deal with waiting queue
-        listAction* queue = NULL;
-        {
-            std::lock_guard<std::mutex> _auto_lock(bridge->_lock);
-            queue = bridge->_waitings;
-            bridge->_waitings = bridge->_waitings == &bridge->_waitings_cache[0] ? &bridge->_waitings_cache[1] : &bridge->_waitings_cache[0];
+    int64_t window = bridge->_idleGap ? bridge->_spinWindow : bridge->_spinMax.load(std::memory_order_relaxed); /*not learned yet*/
+    if (window <= 0) {
+        return false;
+    }
+    bool timer = timeout > 0 && timeout <= window; /*the next timer is due within the window*/
+    if (timer) {
+        window = timeout;
+    }
+    int64_t now = idle;
+    for (;;) {
+        if (!bridge->_waitings.empty() || wait(0) > 0) {//a wakeup saved
+            now = getUptimeInMicroseconds();
+            runnable_bridge::count(bridge->_spinHits);
+            bridge->adapt(now - idle);
+            break;
         }
-        listAction::action_t* it = queue->_head.next;
-        while (it->next) {
-            listAction::action_t* one = it;
-            it = it->next;
-            switch (one->mode) {
-                case listAction::action_t::push: {
-                    if (one->period) { //delay
-                        bridge->_delays.insert(one);
-                    }
-                    else {
-                        bridge->_realtimes.addToTail(one);
-                    }
-                } break;
-                    
-                case listAction::action_t::cancel : {
-                    if (one->id != runnable::invalid_task_id) {//by idb
-                        bool found = false;
-                        {//find it from realtimes
-                            listAction::action_t* prev = &bridge->_realtimes._head, *it = bridge->_realtimes._head.next;
-                            while (it) {
-                                if (it->id == one->id) {//found
-                                    prev->next = it->next;
-                                    if (prev->next == NULL) { // touch the end
-                                        bridge->_realtimes._tail = prev;
-                                    }
-                                    delete it;
-                                    found = true;
-                                    break;
-                                }
-                                prev = it;
-                                it = it->next;
-                            }
-                        }
-                        if (!found) {//find it from delays
-                            listAction::action_t *it = bridge->_delays._head.next;
-                            while (it) {
-                                if (it->id == one->id) {//found
-                                    bridge->_delays.remove(it);
-                                    break;
-                                }
-                                it = it->next;
-                            }
-                        }
-                    }
-                    else if (one->call->owner()) {//by owner
-                        void* own = one->call->owner();
-                        {//find it from realtimes
-                            listAction::action_t* prev = &bridge->_realtimes._head, *it = bridge->_realtimes._head.next;
-                            while (it) {
-                                if (it->call->owner() == own) {//found
-                                    prev->next = it->next;
-                                    if (prev->next == NULL) { // touch the end
-                                        bridge->_realtimes._tail = prev;
-                                    }
-                                    delete it;
-                                    it = prev->next;
-                                }
-                                else {
-                                    prev = it;
-                                    it = it->next;
-                                }
-                            }
-                        }
-                        {//find it from delays
-                            listAction::action_t* prev = &bridge->_delays._head, *it = bridge->_delays._head.next;
-                            while (it) {
-                                if (it->call->owner() == own) {//found
-                                    prev->next = it->next;
-                                    if (prev->next == NULL) { // touch the end
-                                        bridge->_delays._tail = prev;
-                                    }
-                                    delete it;
-                                    it = prev->next;
-                                }
-                                else {
-                                    prev = it;
-                                    it = it->next;
-                                }
-                            }
-                        }
-                        {//find it from listeners
-                            mapListener::iterator it = bridge->_listeners.begin();
-                            while (it != bridge->_listeners.end()) {
-                                if (it->second.first == own) {
-                                    close(it->first);
-#if __cplusplus > 199711L
-                                    it = bridge->_listeners.erase(it);
-#else
-                                    bridge->sockets.erase(it++);
-#endif
-                                }
-                            }
-                        }
-                    }
-                    else {
-                        //error
-                        log_error("logic error");
-                    }
-                    delete one;
-                } break;
-                    
-                case listAction::action_t::listen : {
-                    bridge->_listeners[(int)one->id] = std::make_pair(reinterpret_cast<listener*>(one->call->owner()), false);
-                    delete one;
-                } break;
-                    
-                case listAction::action_t::unlisten : {
-                    mapListener::iterator it = bridge->_listeners.find((int)one->id);
-                    if (it != bridge->_listeners.end()) {
-                        bridge->_listeners.erase(it);
-                    }
-                    delete one;
-                } break;
-
-                case listAction::action_t::markWritable : {
-                    mapListener::iterator it = bridge->_listeners.find((int)one->id);
-                    if (it != bridge->_listeners.end()) {
-                        it->second.second = one->count ? true : false;
-                    }
-                    delete one;
-                } break;
-                    
-                default: {
-                    delete one;
-                } break;
+        now = getUptimeInMicroseconds();
+        if (now - idle >= window) {
+            if (!timer) {
+                runnable_bridge::count(bridge->_spinMisses);
+                runnable_bridge::count(bridge->_spinTime, now - idle);
+                return false;
             }
+            break;
         }
-        queue->_head.next = it;
+        std::this_thread::yield(); /*give the producers a chance if they share the core*/
     }
-    if (bridge->_realtimes._head.next) {//deal with realtime queue
-        listAction::action_t* it = bridge->_realtimes._head.next;
-        while (it) {
-            listAction::action_t* itrm = it;
-            itrm->call->invoke();
-            it = it->next;
-            delete itrm;
+    runnable_bridge::count(bridge->_spinTime, now - idle);
+    return true;
+}
+
+int64_t runnable::excute(void) {
+    runnable_bridge* bridge = _bridge.get();
+    {//deal with waiting queue
+        listAction::action_t* one = nullptr;
+        bool traced = trace::enabled();
+        while ((one = bridge->_waitings.pop()) != nullptr) {
+            if (traced && one->mode == listAction::action_t::push) {
+                int64_t now = trace::now();
+                trace::record(trace::EVENT_DEQUEUE, bridge, one->id, now, now, &one->call.type(), one->owner);
+            }
+            bridge->apply(one);
         }
-        bridge->_realtimes._head.next = NULL;
-        bridge->_realtimes._tail = &bridge->_realtimes._head;
     }
-    if (bridge->_delays._head.next) {//deal with delay queue
-        listAction::action_t* it = bridge->_delays._head.next;
-        while (it) {
-            int64_t tv = getUptimeInMilliseconds();
-            if (it->timeout > tv) {
-                break;
-            }
-            listAction::action_t* one = it;
-            one->call->invoke();
-            it = it->next;
-            if (--(one->count) == 0) {
-                bridge->_delays.remove(one);
-            }
-            else {
-                one->timeout = getUptimeInMilliseconds() + one->period;
-                bridge->_delays.moveToTail(one);
-            }
+    if (bridge->_overload.load(std::memory_order_relaxed) == OVERLOAD_DROP_OLDEST) {
+        size_t capacity = bridge->_capacity.load(std::memory_order_relaxed);
+        if (capacity) bridge->shed(capacity);
+    }
+    bridge->run(bridge->_urgents, (size_t)-1, 0);
+    
+    //timers and bulk lane share the budget of this iteration
+    size_t  budget = bridge->_budgetTasks.load(std::memory_order_relaxed);
+    int64_t span = bridge->_budgetTime.load(std::memory_order_relaxed);
+    if (budget == 0) budget = (size_t)-1;
+    int64_t now = getUptimeInMicroseconds(); /*read once for the whole delay queue*/
+    int64_t deadline = span ? now + span : 0;
+    while (bridge->_delays.size() && budget) {//deal with delay queue
+        listAction::action_t* one = bridge->_delays.top();
+        if (one->timeout > now) {
+            break;
+        }
+        bridge->_current = one;
+        bridge->invoke(one);
+        bridge->_current = nullptr;
+        if (one->consumed) {//canceled while invoking
+            bridge->_delays.erase(one);
+            bridge->_owners.erase(one);
+            bridge->release(one);
+        }
+        else if (--(one->count) == 0) {
+            bridge->_handles.erase(one->id);
+            bridge->_delays.erase(one);
+            bridge->_owners.erase(one);
+            bridge->release(one);
         }
+        else {//re-arm in place
+            one->timeout = now + one->period;
+            bridge->_delays.update(one->slot);
+        }
+        if (--budget && deadline && (budget & 15) == 0 && getUptimeInMicroseconds() >= deadline) {
+            budget = 0;
+        }
+    }
+    if (budget) {
+        bridge->run(bridge->_realtimes, budget, deadline);
+    }
+    bridge->room();
+    if (bridge->_urgents._head.next || bridge->_realtimes._head.next) {
+        return 0;
     }
-    return 0;
+    if (bridge->_delays.size() == 0) {
+        return -1;
+    }
+    int64_t left = bridge->_delays.top()->timeout - getUptimeInMicroseconds();
+    return left > 0 ? left : 0;
 }
 
-void    runnable::wait(int64_t milliseconds) {
-    fd_set    fdrset, fdwset, fdeset;
-#if defined(__APPLE__)
-    typedef __darwin_time_t __second_t;
-    typedef __darwin_suseconds_t  __suseconds_t;
-#else
-    typedef time_t __second_t;
-    typedef long  __suseconds_t;
-#endif
-    struct    timeval to = {static_cast<__second_t>(milliseconds / 1000), static_cast<__suseconds_t>((milliseconds % 1000) * 1000)};
+int     runnable::wait(int64_t microseconds) {
     runnable_bridge* bridge = _bridge.get();
+    poller::event_t events[poller::max_events];
 
-    FD_ZERO(&fdrset);
-    FD_ZERO(&fdwset);
-    FD_ZERO(&fdeset);
-    
-    int fd = 0;
-    
-    if (bridge->_listeners.size()) {
-        for (mapListener::iterator it = bridge->_listeners.begin(); it != bridge->_listeners.end(); it++) {
-            FD_SET(it->first, &fdrset);
-            FD_SET(it->first, &fdeset);
-            if (it->second.second) {
-                FD_SET(it->first, &fdwset);
-            }
-        }
-        fd = (--bridge->_listeners.end())->first;
+    bool watched = bridge->_watched;
+    if (watched) {
+        bridge->_busySince.store(0, std::memory_order_relaxed);
     }
-    if (bridge->_signals[0] > fd) {
-        fd = bridge->_signals[0];
+    int r = bridge->_poller->wait(microseconds, events, poller::max_events);
+    if (watched) {
+        bridge->_busySince.store(getUptimeInMicroseconds(), std::memory_order_relaxed);
     }
-    if (bridge->_signals[1] > fd) {
-        fd = bridge->_signals[1];
-    }
-    FD_SET(bridge->_signals[0], &fdrset);
-    FD_SET(bridge->_signals[0], &fdeset);
-    FD_SET(bridge->_signals[1], &fdrset);
-    FD_SET(bridge->_signals[1], &fdeset);
-    
-    int r = select((int)fd + 1, &fdrset, &fdwset, &fdeset, &to);
-    
+
     if (r == 0) {//nothing happen
-        return;
+        return 0;
     }
     else if ( r == -1) {
-        if (EBADF == errno || ERANGE == errno) {
-            for (mapListener::iterator it = bridge->_listeners.begin(); it != bridge->_listeners.end(); ) {
-                if (!fd_isvalid(it->first)) { //except
-                    it->second.first->onClose(it->first);
-#if __cplusplus > 199711L
-                    it = bridge->_listeners.erase(it);
-#else
-                    bridge->_listeners.erase(it++);
-#endif
-                }
-                else {
-                    ++it;
-                }
-            }
-        }
-        else {
-            std::this_thread::sleep_for(std::chrono::duration<long double, std::milli>(10));
-        }
-    }
-    else if (r == 1 && FD_ISSET(bridge->_signals[0], &fdrset)) { /*signal coming*/
-        unsigned char buf[1024];
-        ssize_t rx = 0;
-        while((rx = read(bridge->_signals[0], buf, sizeof(buf))) > 0);
+        std::this_thread::sleep_for(std::chrono::duration<long double, std::milli>(10));
+        return 0;
     }
-    else {
-        if (FD_ISSET(bridge->_signals[0], &fdrset)) {
+    int dispatched = 0;
+    for (int i = 0; i < r; i++) {
+        poller::event_t& ev = events[i];
+        if (ev.fd == bridge->_signals[0]) { /*signal coming*/
             unsigned char buf[1024];
             ssize_t rx = 0;
             while((rx = read(bridge->_signals[0], buf, sizeof(buf))) > 0);
+            continue;
+        }
+        mapListener::iterator it = bridge->_listeners.find(ev.fd);
+        if (it == bridge->_listeners.end()) {
+            continue;
         }
-        for (mapListener::iterator it = bridge->_listeners.begin(); it != bridge->_listeners.end(); it++) {
-            if (FD_ISSET(it->first, &fdrset)) {//data coming ?
-                size_t  count = 0;
+        listener* lis = it->second.first;
+        int64_t begin = watched ? bridge->enter(typeid(*lis), lis) : 0;
+        if (ev.broken) { //except
+            bridge->_owners.erase(lis, ev.fd);
+            bridge->_listeners.erase(it);
+            lis->onClose(ev.fd);
+        }
+        else if (ev.readable) {//data coming ?
+            size_t  count = 0;
 #ifdef _OS_WIN_
-                u_long lcount = 0;
-                ioctlsocket(it->first, FIONREAD, &lcount);
-                count = lcount;
+            u_long lcount = 0;
+            ioctlsocket(ev.fd, FIONREAD, &lcount);
+            count = lcount;
 #else
-                ioctl(it->first, FIONREAD, &count);
+            ioctl(ev.fd, FIONREAD, &count);
 #endif
-                it->second.first->onRecv(it->first, count);
-            }
-            else if (FD_ISSET(it->first, &fdwset)) {//writable ?
-                it->second.second = false;
-                it->second.first->onWritable(it->first);
-            }
+            lis->onRecv(ev.fd, count);
         }
-    }
-}
-
-//background mode
-struct  background : public ts::life {
-private:
-    std::mutex  _lock;
-    std::list<std::shared_ptr<ts::runnable>> _threads;
-    std::unique_ptr<ts::runnable>   _cleaner;
-public:
-    background(void) {
-        _cleaner.reset(new ts::runnable("tsCleaner"));
-        _cleaner->start();
-    }
-    
-    std::shared_ptr<ts::runnable> pop(void) {
-        std::lock_guard<std::mutex> _auto_lock(_lock);
-        if (_threads.size() == 0) {
-            ts::runnable* ra = new ts::runnable("tsBackground");
-            if (ra->start() == false) {
-                ra->fly();
-                throw std::runtime_error("failed to start thread!");
-            }
-            return std::static_pointer_cast<ts::runnable>(ra->clone());
+        else if (ev.writable) {//writable ?
+            it->second.second = false;
+            bridge->_poller->modify(ev.fd, false);
+            lis->onWritable(ev.fd);
         }
-        std::shared_ptr<ts::runnable> it = _threads.front(); _threads.pop_front();
-        it->reset();
-        return it;
-    }
-
-    void push(std::shared_ptr<ts::runnable>& ra) {
-        std::lock_guard<std::mutex> _auto_lock(_lock);
-        _threads.push_back(ra);
-        
-        runnable::push(ts::make_bind(this, &background::shutdown, ra), 3000, 1, ra.get()); //30 seconds later
-    }
-    
-    void shutdown(std::shared_ptr<ts::runnable> ra) {
-        std::lock_guard<std::mutex> _auto_lock(_lock);
-        std::list<std::shared_ptr<ts::runnable>>::iterator it = std::find(_threads.begin(), _threads.end(), ra);
-        if (it == _threads.end()) {//ite must be poped up by runnable::background
-            return;
+        if (begin) {
+            bridge->leave(begin, ev.broken ? trace::EVENT_CLOSE : (ev.readable ? trace::EVENT_RECV : trace::EVENT_WRITABLE), ev.fd, ev.fd);
         }
-        _threads.remove(*it);
-        runnable::push(ts::make_bind(this, &background::clean, ra), 0, 1, _cleaner.get());
+        dispatched++;
     }
-    
-    void clean(std::shared_ptr<ts::runnable> ra) {
-        ra->stop()->join();
-    }
-
-    void run(std::shared_ptr<ts::runnable> ra, std::shared_ptr<runnable::bind_base_t> c) {
-        c->invoke();
-        push(ra);
-    }
-};
+    return dispatched;
+}
 
 void     runnable::background(std::shared_ptr<bind_base_t> ca) {
-    static std::shared_ptr<struct background> s_bg(new struct background());
-    std::shared_ptr<ts::runnable> ra = s_bg->pop();
-    runnable::push(ts::make_bind(s_bg.get(), &background::run, ra, ca), 0, 1, ra.get());
+    void* owner = ca ? ca->owner() : nullptr;
+    background(task([ca]() {ca->invoke();}, owner));
+}
+
+void     runnable::background(task&& ta) {
+    runnable* ra = current();
+    pool* target = ra ? ra->_bridge->_background.load(std::memory_order_acquire) : nullptr;
+    (target ? *target : pool::shared()).submit(std::move(ta));
 }
 
 //for explicitThreaded
@@ -0,0 +1,602 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <ts/file.h>
+#include <ts/pool.h>
+#include <ts/log.h>
+#if defined(_OS_LINUX_)
+# include <sys/syscall.h>
+# if defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   include <sys/mman.h>
+#   include <linux/io_uring.h>
+#   if defined(IORING_FEAT_RW_CUR_POS) && defined(STATX_BASIC_STATS) /*openat, read, write, statx and close came with it*/
+#    define _TS_FILE_URING_   1
+#   endif
+#  endif
+# endif
+#endif
+
+_TS_NAMESPACE_USING
+_TS_NAMESPACE_BEGIN
+
+void renameThread(const char* name);
+
+//for file_op
+//__________________________________________________________________________
+struct file_op {
+    typedef enum {OP_OPEN = 0, OP_CLOSE, OP_READ, OP_WRITE, OP_FSYNC, OP_STAT} code_t;
+
+    code_t      code;
+    int         fd;
+    int         flags;
+    int         mode;
+    int64_t     offset;
+    size_t      size;
+    size_t      done;       //bytes written
+    std::string path;
+    std::shared_ptr<std::string>    data;
+    file::result_t      result;
+    file::callback_t    callback;
+    runnable*   target;     //where callback runs, nullptr for the io thread
+#if defined(_TS_FILE_URING_)
+    struct statx        stx;
+#endif
+
+    file_op(code_t c, file::callback_t&& cb, runnable* to) : code(c), fd(-1), flags(0), mode(0), offset(-1), size(0), done(0), result{0, -1, 0, 0, 0, nullptr}, callback(std::move(cb)), target(to) {}
+};
+
+static void deliver(runnable* target, const file::callback_t& cb, const file::result_t& res) {
+    if (cb == nullptr) {
+        return;
+    }
+    if (target) {
+        file::callback_t fn(cb);
+        file::result_t r(res);
+        runnable::push(task([fn, r]() mutable {
+            fn(r);
+        }), 0, 1, target, runnable::LANE_URGENT);
+    }
+    else {
+        file::result_t r(res);
+        cb(r);
+    }
+}
+
+//illegal arguments complete like a failed op, with EINVAL on the calling runnable
+static void refuse(const file::callback_t& cb, std::shared_ptr<std::string> data = nullptr) {
+    log_error("illegal argment!");
+    file::result_t res = {EINVAL, -1, 0, 0, 0, data};
+    deliver(runnable::current(), cb, res);
+}
+
+static void finish(file_op* op) {
+    deliver(op->target, op->callback, op->result);
+    delete op;
+}
+
+//blocking version, run by io threads
+static void perform(file_op* op) {
+    file::result_t& res = op->result;
+    int64_t n = 0;
+    switch (op->code) {
+        case file_op::OP_OPEN:
+            if ((res.fd = ::open(op->path.c_str(), op->flags | O_CLOEXEC, op->mode)) == -1) {
+                res.err = errno;
+            }
+            break;
+        case file_op::OP_CLOSE:
+            if (::close(op->fd) == -1) {
+                res.err = errno;
+            }
+            break;
+        case file_op::OP_READ:
+            n = op->offset < 0 ? ::read(op->fd, &(*op->data)[0], op->size) : ::pread(op->fd, &(*op->data)[0], op->size, op->offset);
+            if (n < 0) {
+                res.err = errno;
+                n = 0;
+            }
+            op->data->resize((size_t)n);
+            res.size = n;
+            res.data = op->data;
+            break;
+        case file_op::OP_WRITE:
+            while (op->done < op->size) {
+                const char* p = op->data->data() + op->done;
+                n = op->offset < 0 ? ::write(op->fd, p, op->size - op->done) : ::pwrite(op->fd, p, op->size - op->done, op->offset + (int64_t)op->done);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    res.err = n < 0 ? errno : 0;
+                    break;
+                }
+                op->done += (size_t)n;
+            }
+            res.size = (int64_t)op->done;
+            break;
+        case file_op::OP_FSYNC:
+            if (::fsync(op->fd) == -1) {
+                res.err = errno;
+            }
+            break;
+        case file_op::OP_STAT: {
+            struct stat st;
+            if (::stat(op->path.c_str(), &st) == -1) {
+                res.err = errno;
+                break;
+            }
+            res.size = (int64_t)st.st_size;
+            res.mode = (uint32_t)st.st_mode;
+            res.mtime= (int64_t)st.st_mtime;
+            break;
+        }
+    }
+    finish(op);
+}
+
+#if defined(_TS_FILE_URING_)
+//for file_uring
+//__________________________________________________________________________
+/*a ring of its own, submitters share the sq under a lock and a reaper thread blocks for completions,
+ user_data is the file_op. requests beyond the cq are handed to the io threads instead of overflowing it*/
+struct file_uring {
+    int         _fd;
+    void*       _sq_ptr;
+    size_t      _sq_size;
+    void*       _cq_ptr;
+    size_t      _cq_size;
+    struct io_uring_sqe*    _sqes;
+    size_t      _sqes_size;
+    unsigned    *_sq_head, *_sq_tail, *_sq_mask, *_sq_array;
+    unsigned    _sq_entries;
+    unsigned    *_cq_head, *_cq_tail, *_cq_mask;
+    struct io_uring_cqe*    _cqes;
+    unsigned    _cq_entries;
+    std::mutex  _lock;
+    std::unordered_set<file_op*>    _ops;   /*submitted and not reaped yet, under _lock*/
+    bool        _broken;    /*reaper is gone, under _lock*/
+    std::atomic<unsigned>   _inflight;
+    std::thread _reaper;
+
+    file_uring(void) : _fd(-1), _sq_ptr(MAP_FAILED), _sq_size(0), _cq_ptr(MAP_FAILED), _cq_size(0), _sqes((struct io_uring_sqe*)MAP_FAILED), _sqes_size(0), _cq_entries(0), _broken(false), _inflight(0) {}
+    ~file_uring(void) {
+        if (_sqes != MAP_FAILED) munmap(_sqes, _sqes_size);
+        if (_cq_ptr != MAP_FAILED && _cq_ptr != _sq_ptr) munmap(_cq_ptr, _cq_size);
+        if (_sq_ptr != MAP_FAILED) munmap(_sq_ptr, _sq_size);
+        if (_fd != -1) ::close(_fd);
+    }
+
+    bool setup(unsigned entries) {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        _fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (_fd < 0) {
+            _fd = -1;
+            return false;
+        }
+        if ((p.features & IORING_FEAT_RW_CUR_POS) == 0) {//kernel before 5.6, file opcodes are missing
+            errno = ENOSYS;
+            return false;
+        }
+        _sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        _cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+        }
+        _sq_ptr = mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        if (_sq_ptr == MAP_FAILED) {
+            return false;
+        }
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            _cq_ptr = _sq_ptr;
+        }
+        else if ((_cq_ptr = mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING)) == MAP_FAILED) {
+            return false;
+        }
+        _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        _sqes = (struct io_uring_sqe*)mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+        if (_sqes == MAP_FAILED) {
+            return false;
+        }
+        char* sq = (char*)_sq_ptr;
+        _sq_head    = (unsigned*)(sq + p.sq_off.head);
+        _sq_tail    = (unsigned*)(sq + p.sq_off.tail);
+        _sq_mask    = (unsigned*)(sq + p.sq_off.ring_mask);
+        _sq_array   = (unsigned*)(sq + p.sq_off.array);
+        _sq_entries = p.sq_entries;
+        char* cq = (char*)_cq_ptr;
+        _cq_head    = (unsigned*)(cq + p.cq_off.head);
+        _cq_tail    = (unsigned*)(cq + p.cq_off.tail);
+        _cq_mask    = (unsigned*)(cq + p.cq_off.ring_mask);
+        _cqes       = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+        _cq_entries = p.cq_entries;
+        _reaper = std::thread(&file_uring::reap, this);
+        return true;
+    }
+
+    //false if the ring is busy, the caller should take another way
+    bool submit(file_op* op) {
+        if (_inflight.fetch_add(1, std::memory_order_relaxed) >= _cq_entries) {
+            _inflight.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::lock_guard<std::mutex> _auto_lock(_lock);
+        unsigned tail = *_sq_tail;
+        if (_broken || tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) >= _sq_entries) {
+            _inflight.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        unsigned index = tail & *_sq_mask;
+        struct io_uring_sqe* e = &_sqes[index];
+        memset(e, 0, sizeof(*e));
+        e->user_data = (uint64_t)(uintptr_t)op;
+        switch (op->code) {
+            case file_op::OP_OPEN:
+                e->opcode = IORING_OP_OPENAT;
+                e->fd = AT_FDCWD;
+                e->addr = (uint64_t)(uintptr_t)op->path.c_str();
+                e->len = (uint32_t)op->mode;
+                e->open_flags = (uint32_t)(op->flags | O_CLOEXEC);
+                break;
+            case file_op::OP_CLOSE:
+                e->opcode = IORING_OP_CLOSE;
+                e->fd = op->fd;
+                break;
+            case file_op::OP_READ:
+                e->opcode = IORING_OP_READ;
+                e->fd = op->fd;
+                e->addr = (uint64_t)(uintptr_t)&(*op->data)[0];
+                e->len = (uint32_t)op->size;
+                e->off = op->offset < 0 ? (uint64_t)-1 : (uint64_t)op->offset;
+                break;
+            case file_op::OP_WRITE:
+                e->opcode = IORING_OP_WRITE;
+                e->fd = op->fd;
+                e->addr = (uint64_t)(uintptr_t)(op->data->data() + op->done);
+                e->len = (uint32_t)(op->size - op->done);
+                e->off = op->offset < 0 ? (uint64_t)-1 : (uint64_t)(op->offset + (int64_t)op->done);
+                break;
+            case file_op::OP_FSYNC:
+                e->opcode = IORING_OP_FSYNC;
+                e->fd = op->fd;
+                break;
+            case file_op::OP_STAT:
+                e->opcode = IORING_OP_STATX;
+                e->fd = AT_FDCWD;
+                e->addr = (uint64_t)(uintptr_t)op->path.c_str();
+                e->len = STATX_SIZE | STATX_MODE | STATX_MTIME;
+                e->off = (uint64_t)(uintptr_t)&op->stx;
+                break;
+        }
+        _sq_array[index] = index;
+        _ops.insert(op);
+        __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        while (syscall(__NR_io_uring_enter, _fd, 1, 0, 0, nullptr, 0) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EBUSY) {//the entry stays in sq, submitted along with the next one
+                break;
+            }
+            log_error("io_uring_enter failed, err=%s!", strerror(errno));
+            break;
+        }
+        return true;
+    }
+
+    void complete(file_op* op, int res);
+
+    void reap(void) {
+        renameThread("tsFileIO");
+        std::vector<std::pair<file_op*, int>> reaped;
+        while (true) {
+            if (syscall(__NR_io_uring_enter, _fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                int err = errno;
+                log_error("io_uring_enter failed, err=%s!", strerror(err));
+                fail(err);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> _auto_lock(_lock);
+                unsigned head = *_cq_head;
+                unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+                for (; head != tail; head++) {
+                    const struct io_uring_cqe& cqe = _cqes[head & *_cq_mask];
+                    file_op* op = (file_op*)(uintptr_t)cqe.user_data;
+                    reaped.push_back(std::make_pair(op, cqe.res));
+                    _ops.erase(op);
+                    __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+                }
+            }
+            for (size_t i = 0; i < reaped.size(); i++) {
+                _inflight.fetch_sub(1, std::memory_order_relaxed);
+                complete(reaped[i].first, reaped[i].second);
+            }
+            reaped.clear();
+        }
+    }
+
+    //nothing reaps any more, ops in the ring fail with err and later ones go to the io threads
+    void fail(int err) {
+        std::unordered_set<file_op*> ops;
+        {
+            std::lock_guard<std::mutex> _auto_lock(_lock);
+            _broken = true;
+            ops.swap(_ops);
+        }
+        for (std::unordered_set<file_op*>::iterator it = ops.begin(); it != ops.end(); ++it) {
+            _inflight.fetch_sub(1, std::memory_order_relaxed);
+            complete(*it, -err);
+        }
+    }
+};
+#endif
+
+//for file_cxt
+//__________________________________________________________________________
+struct file_cxt {
+    file::engine_t  engine;
+    pool            workers;
+#if defined(_TS_FILE_URING_)
+    file_uring*     uring;
+#endif
+
+    explicit file_cxt(file::engine_t preferred) : engine(file::ENGINE_POOL), workers("tsFileIO", 0, 4)
+#if defined(_TS_FILE_URING_)
+    , uring(nullptr)
+#endif
+    {
+#if defined(_TS_FILE_URING_)
+        if (preferred == file::ENGINE_URING) {//one enter per op, slower than the pool until submissions are batched
+            std::unique_ptr<file_uring> ring(new file_uring());
+            if (ring->setup(256)) {
+                uring = ring.release();
+                engine = file::ENGINE_URING;
+            }
+            else {
+                log_warning("failed to setup io_uring for files, err=%s, fallback to io threads!", strerror(errno));
+            }
+        }
+#else
+        (void)preferred;
+#endif
+    }
+
+    void submit(file_op* op) {
+#if defined(_TS_FILE_URING_)
+        if (uring && uring->submit(op)) {
+            return;
+        }
+#endif
+        if (!workers.submit(task([op]() {
+            perform(op);
+        }))) {
+            op->result.err = ECANCELED;
+            finish(op);
+        }
+    }
+};
+
+static std::atomic<int> _preferred(file::ENGINE_DEFAULT);
+
+static file_cxt& shared(void) {
+    static file_cxt* s_cxt = new file_cxt((file::engine_t)_preferred.load()); /*never destroyed, same as pool::shared*/
+    return *s_cxt;
+}
+
+#if defined(_TS_FILE_URING_)
+void file_uring::complete(file_op* op, int res) {
+    file::result_t& r = op->result;
+    if (res < 0) {
+        r.err = -res;
+        if (op->code == file_op::OP_READ) {
+            op->data->clear();
+            r.data = op->data;
+        }
+        else if (op->code == file_op::OP_WRITE) {
+            r.size = (int64_t)op->done;
+        }
+        finish(op);
+        return;
+    }
+    switch (op->code) {
+        case file_op::OP_OPEN:
+            r.fd = res;
+            break;
+        case file_op::OP_READ:
+            op->data->resize((size_t)res);
+            r.size = res;
+            r.data = op->data;
+            break;
+        case file_op::OP_WRITE:
+            op->done += (size_t)res;
+            if (res > 0 && op->done < op->size) {//short write, continue with the rest
+                shared().submit(op);
+                return;
+            }
+            r.size = (int64_t)op->done;
+            break;
+        case file_op::OP_STAT:
+            r.size = (int64_t)op->stx.stx_size;
+            r.mode = op->stx.stx_mode;
+            r.mtime= (int64_t)op->stx.stx_mtime.tv_sec;
+            break;
+        default:
+            break;
+    }
+    finish(op);
+}
+#endif
+
+//for file
+//__________________________________________________________________________
+static void submit(file_op* op) {
+    shared().submit(op);
+}
+
+static void openAt(const std::string& path, int flags, int mode, file::callback_t&& cb, runnable* target) {
+    file_op* op = new file_op(file_op::OP_OPEN, std::move(cb), target);
+    op->path = path;
+    op->flags= flags;
+    op->mode = mode;
+    submit(op);
+}
+
+static void statAt(const std::string& path, file::callback_t&& cb, runnable* target) {
+    file_op* op = new file_op(file_op::OP_STAT, std::move(cb), target);
+    op->path = path;
+    submit(op);
+}
+
+static void readAt(int fd, size_t size, int64_t offset, file::callback_t&& cb, runnable* target) {
+    file_op* op = new file_op(file_op::OP_READ, std::move(cb), target);
+    op->fd  = fd;
+    op->size= size;
+    op->offset = offset;
+    op->data = std::make_shared<std::string>(size, '\0');
+    submit(op);
+}
+
+static void closeAt(int fd, file::callback_t&& cb, runnable* target) {
+    file_op* op = new file_op(file_op::OP_CLOSE, std::move(cb), target);
+    op->fd = fd;
+    submit(op);
+}
+
+void file::open(const char* path, int flags, int mode, callback_t cb) {
+    if (path == nullptr || *path == 0) {
+        return refuse(cb);
+    }
+    openAt(path, flags, mode, std::move(cb), runnable::current());
+}
+
+void file::close(int fd, callback_t cb) {
+    if (fd < 0) {
+        return refuse(cb);
+    }
+    closeAt(fd, std::move(cb), runnable::current());
+}
+
+void file::read(int fd, size_t size, int64_t offset, callback_t cb) {
+    if (fd < 0 || size > 0x7ffff000) {
+        return refuse(cb, std::make_shared<std::string>()); /*a failed read has empty data, not none*/
+    }
+    readAt(fd, size, offset, std::move(cb), runnable::current());
+}
+
+void file::write(int fd, std::shared_ptr<std::string> data, int64_t offset, callback_t cb) {
+    if (fd < 0 || data == nullptr || data->size() > 0x7ffff000) {
+        return refuse(cb);
+    }
+    file_op* op = new file_op(file_op::OP_WRITE, std::move(cb), runnable::current());
+    op->fd  = fd;
+    op->size= data->size();
+    op->offset = offset;
+    op->data= std::move(data);
+    submit(op);
+}
+
+void file::fsync(int fd, callback_t cb) {
+    if (fd < 0) {
+        return refuse(cb);
+    }
+    file_op* op = new file_op(file_op::OP_FSYNC, std::move(cb), runnable::current());
+    op->fd = fd;
+    submit(op);
+}
+
+void file::stat(const char* path, callback_t cb) {
+    if (path == nullptr || *path == 0) {
+        return refuse(cb);
+    }
+    statAt(path, std::move(cb), runnable::current());
+}
+
+//steps in between run on the io thread, only the last one goes to target
+static void readFileAt(const std::string& name, file::callback_t&& cb, runnable* target) {
+    statAt(name, [name, cb, target](file::result_t& st) {
+        if (st.err) {
+            return deliver(target, cb, st);
+        }
+        if (st.size > 0x7ffff000) {
+            st.err = EFBIG;
+            return deliver(target, cb, st);
+        }
+        openAt(name, O_RDONLY, 0, [st, cb, target](file::result_t& op) {
+            if (op.err) {
+                return deliver(target, cb, op);
+            }
+            int fd = op.fd;
+            readAt(fd, (size_t)st.size, 0, [st, cb, target, fd](file::result_t& rd) {
+                closeAt(fd, nullptr, nullptr);
+                rd.fd   = -1;
+                rd.mode = st.mode;
+                rd.mtime= st.mtime;
+                deliver(target, cb, rd);
+            }, nullptr);
+        }, nullptr);
+    }, nullptr);
+}
+
+void file::readFile(const char* path, callback_t cb) {
+    if (path == nullptr || *path == 0) {
+        return refuse(cb);
+    }
+    readFileAt(path, std::move(cb), runnable::current());
+}
+
+static void loaded(runnable* target, const file::loaded_t& cb, bool ok, std::shared_ptr<pie> out, std::shared_ptr<std::string> err) {
+    task done([cb, ok, out, err]() {
+        cb(ok, *out, *err);
+    });
+    if (target) {
+        runnable::push(std::move(done), 0, 1, target, runnable::LANE_URGENT);
+    }
+    else {
+        done();
+    }
+}
+
+void file::loadFile(const char* path, parser_t parser, loaded_t cb) {
+    runnable* target = runnable::current();
+    if (path == nullptr || *path == 0 || parser == nullptr || cb == nullptr) {
+        log_error("illegal argment!");
+        if (cb) {
+            loaded(target, cb, false, std::make_shared<pie>(), std::make_shared<std::string>("illegal argument"));
+        }
+        return;
+    }
+    std::string name(path);
+    readFileAt(name, [name, parser, cb, target](result_t& res) {
+        std::shared_ptr<pie> out(new pie());
+        std::shared_ptr<std::string> err(new std::string());
+        bool ok = false;
+        if (res.err) {
+            log_error("file[%s] %s!", name.c_str(), strerror(res.err));
+            *err = strerror(res.err);
+        }
+        else {
+            ok = parser(res.data->c_str(), *out, *err);
+        }
+        loaded(target, cb, ok, out, err);
+    }, nullptr);
+}
+
+file::engine_t file::setEngine(engine_t engine) {
+    _preferred.store(engine);
+    return shared().engine;
+}
+
+file::engine_t file::engine(void) {
+    return shared().engine;
+}
+
+_TS_NAMESPACE_END
@@ -3,6 +3,7 @@
 #include <ts/json.h>
 #include <ts/string.h>
 #include <ts/log.h>
+#include <ts/file.h>
 
 _TS_NAMESPACE_USING
 
@@ -588,6 +589,12 @@ namespace json {
         return parse(out, szb.get(), err);
     }
     
+    void            fromFileAsync(const char* file, loaded_t cb) {
+        ts::file::loadFile(file, [](const char* data, ts::pie& out, std::string& err) {
+            return parse(out, data, err);
+        }, cb);
+    }
+    
     long            toFile(const ts::pie& js, const char* file, bool quot, bool align) {
         std::string s;
         format(js, s, quot, align);
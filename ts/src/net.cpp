@@ -22,6 +22,11 @@
 # include <netinet/in.h>
 #endif
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <ts/string.h>
 #include <ts/net.h>
 #include <ts/log.h>
@@ -191,13 +196,25 @@ namespace net {
         address_impl_t  __local;
         address_impl_t  __peer;
         
+        /*set by the owner, tears it down when the application closes it, the poller may not report a closed fd*/
+        std::function<void(int fd)> __closed;
+        
+        runnable*   host(void) const {
+            return const_cast<runnable*>(__s);
+        }
+        
+        //dropped by the owner, closing it later touches neither the fd nor the owner
+        void        detach(void) {
+            _fd = net::invalid_sock;
+            __closed = nullptr;
+        }
+        
         const int   send(std::shared_ptr<std::string> &packet) {
             if (__s->verify() == false) {
                 return -1;
             }
             return connection::send(packet);
         }
-
     };
     typedef std::map<int, std::shared_ptr<connection_t>> mapConnection;
     
@@ -217,9 +234,18 @@ namespace net {
     }
 
     void    connection::close(void) {
+        if (_fd == net::invalid_sock) {
+            return;
+        }
         log_warning("connection[%d] closed!", _fd);
-        ::close(_fd);
+        int fd = _fd;
         _fd = net::invalid_sock;
+        connection_t* self = dynamic_cast<connection_t*>(this);
+        if (self && self->__closed) {
+            runnable::removeListener(fd, self->__s);
+            self->__closed(fd);
+        }
+        ::close(fd);
     }
 
     const int connection::flush(void) {
@@ -246,23 +272,130 @@ namespace net {
 
     //
     //______________________________________________________________________
+    struct server_worker {
+        std::shared_ptr<runnable>   _host;
+        mapConnection               _connections;   /*touched by the worker only*/
+        std::atomic<size_t>         _count;         /*connections handed over, not closed yet*/
+    };
+    
     struct server_cxt {
         int             _sock;
         address_impl_t  _local;
         uint32_t        _concurrent;
-        mapConnection   _connections;
+        mapConnection   _connections;   /*of host, if no workers*/
+        std::vector<std::unique_ptr<server_worker>> _workers;
+        std::unordered_map<const runnable*, server_worker*> _index;    /*workers by runnable, fixed once bound*/
+        server::balance_t   _balance;
+        size_t          _next;          /*for round robin*/
+        
+        //worker of calling thread, nullptr if it is the host
+        server_worker* worker(void) {
+            if (_workers.empty()) {
+                return nullptr;
+            }
+            std::unordered_map<const runnable*, server_worker*>::iterator it = _index.find(runnable::current());
+            return it == _index.end() ? nullptr : it->second;
+        }
+        
+        mapConnection& connections(void) {
+            server_worker* wk = worker();
+            return wk ? wk->_connections : _connections;
+        }
+        
+        void erase(mapConnection::iterator it) {
+            server_worker* wk = worker();
+            if (wk) {
+                wk->_connections.erase(it);
+                wk->_count.fetch_sub(1, std::memory_order_relaxed);
+            }
+            else {
+                _connections.erase(it);
+            }
+        }
+        
+        size_t size(void) const {
+            size_t count = _connections.size();
+            for (size_t i = 0; i < _workers.size(); i++) {
+                count += _workers[i]->_count.load(std::memory_order_relaxed);
+            }
+            return count;
+        }
+        
+        server_worker* pick(void) {
+            if (_balance == server::LEAST_CONNECTIONS) {
+                server_worker* least = _workers[0].get();
+                for (size_t i = 1; i < _workers.size(); i++) {
+                    if (_workers[i]->_count.load(std::memory_order_relaxed) < least->_count.load(std::memory_order_relaxed)) {
+                        least = _workers[i].get();
+                    }
+                }
+                return least;
+            }
+            return _workers[_next++ % _workers.size()].get();
+        }
+        
+        //connections held by the application may outlive the server
+        static void detach(mapConnection& conns) {
+            for (mapConnection::iterator it = conns.begin(); it != conns.end(); ++it) {
+                it->second->detach();
+            }
+        }
+        
+        //cancel tasks and listeners of owner and drop connections on host and every worker, the listening socket goes with the host.
+        //each runs on its own thread, inline for the calling one, and it returns after all are done
+        void shutdown(void* owner, const runnable& host) {
+            std::mutex              lock;
+            std::condition_variable cond;
+            size_t                  pending = 0;
+            
+            for (size_t i = 0; i <= _workers.size(); i++) {
+                runnable* ra = i < _workers.size() ? _workers[i]->_host.get() : const_cast<runnable*>(&host);
+                server_worker* wk = i < _workers.size() ? _workers[i].get() : nullptr;
+                mapConnection* conns = wk ? &wk->_connections : &_connections;
+                if (ra == runnable::current()) {
+                    runnable::cancelOwner(owner);
+                    detach(*conns);
+                    conns->clear();
+                    if (wk) wk->_count = 0;
+                    continue;
+                }
+                if (!ra->running()) {//nothing is dispatched any more
+                    if (!wk && _sock != invalid_sock) {
+                        ::close(_sock);
+                    }
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> _auto_lock(lock);
+                    pending++;
+                }
+                runnable::push(task([owner, conns, wk, &lock, &cond, &pending]() {
+                    runnable::cancelOwner(owner);
+                    detach(*conns);
+                    conns->clear();
+                    if (wk) wk->_count = 0;
+                    std::lock_guard<std::mutex> _auto_lock(lock);
+                    if (--pending == 0) cond.notify_all();
+                }), 0, 1, ra, runnable::LANE_URGENT);
+            }
+            std::unique_lock<std::mutex> _auto_lock(lock);
+            while (pending) {
+                cond.wait(_auto_lock);
+            }
+            _sock = invalid_sock;
+        }
     };
     
     server::server(runnable const& host, uint16_t concurrent) : parasite(host) {
         _cxt = new server_cxt();
         _cxt->_sock = net::invalid_sock;
         _cxt->_concurrent = concurrent + 1;
+        _cxt->_balance = ROUND_ROBIN;
+        _cxt->_next = 0;
     }
     server::~server(void) {
         if (_cxt->_sock != invalid_sock) {
-            runnable::cancelOwner(this);
-            ::close(_cxt->_sock);
-            _cxt->_sock = invalid_sock;
+            _cxt->shutdown(this, _host);
         }
         delete _cxt;
     }
@@ -367,10 +500,9 @@ namespace net {
         }
         
         if (_cxt->_sock != invalid_sock) {
-            runnable::cancelOwner(this, const_cast<runnable*>(&_host));
-            ::close(_cxt->_sock);
-            log_notice("close %s successfully! fd=%d", _cxt->_local.toString().c_str(), _cxt->_sock);
-            _cxt->_sock = invalid_sock;
+            int sock = _cxt->_sock;
+            _cxt->shutdown(this, _host); /*pending handovers and connections on workers as well*/
+            log_notice("close %s successfully! fd=%d", _cxt->_local.toString().c_str(), sock);
         }
         else {
             log_warning("%s aready closed!", _cxt->_local.toString().c_str());
@@ -381,6 +513,31 @@ namespace net {
     int     server::id(void) const {
         return _cxt->_sock;
     }
+    
+    bool    server::setWorkers(const std::vector<std::shared_ptr<runnable>>& workers, balance_t balance) {
+        if (_cxt->_sock != invalid_sock) {
+            log_error("workers must be set before binding!");
+            return false;
+        }
+        _cxt->_workers.clear();
+        _cxt->_index.clear();
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (!workers[i]) {
+                log_error("illegal argment!");
+                _cxt->_workers.clear();
+                _cxt->_index.clear();
+                return false;
+            }
+            server_worker* wk = new server_worker();
+            wk->_host = workers[i];
+            wk->_count = 0;
+            _cxt->_workers.push_back(std::unique_ptr<server_worker>(wk));
+            _cxt->_index[workers[i].get()] = wk;
+        }
+        _cxt->_balance = balance;
+        _cxt->_next = 0;
+        return true;
+    }
 
     //return true if successfully, TCP aways return false
     bool    server::sendto(const address_t& to, const uint8_t* data, uint32_t len) {
@@ -408,8 +565,9 @@ namespace net {
     }
 
     std::shared_ptr<connection> server::getConnection(int fd) {
-        mapConnection::iterator it = _cxt->_connections.find(fd);
-        if (it == _cxt->_connections.end()) {
+        mapConnection& conns = _cxt->connections();
+        mapConnection::iterator it = conns.find(fd);
+        if (it == conns.end()) {
             return std::shared_ptr<connection>();
         }
         return it->second;
@@ -421,8 +579,9 @@ namespace net {
             runnable::wantWritable(fd, false);
             return;
         }
-        mapConnection::iterator it = _cxt->_connections.find(fd);
-        if (it == _cxt->_connections.end()) {
+        mapConnection& conns = _cxt->connections();
+        mapConnection::iterator it = conns.find(fd);
+        if (it == conns.end()) {
             log_error("connection[%d] not found!", fd);
             runnable::removeListener(fd);
             return;
@@ -433,9 +592,11 @@ namespace net {
         }
         else if (tx < 0) {//error occurs
             log_warning("connection[%d] closed!", fd);
+            runnable::removeListener(fd);
             ::close(fd);
+            it->second->detach();
             std::shared_ptr<connection> cnn = std::dynamic_pointer_cast<net::connection>(it->second);
-            _cxt->_connections.erase(it);
+            _cxt->erase(it);
             onConnectionClose(cnn);
         }
     }
@@ -451,15 +612,39 @@ namespace net {
             socklen_t len = sizeof(from);
             int fdnew = accept(_cxt->_sock, &from.vx, &len);
             if (fdnew >= 0) {
-                if (_cxt->_connections.size() < _cxt->_concurrent) {
-                    std::shared_ptr<connection_t> con = std::shared_ptr<connection_t>(new connection_t(&this->_host, fdnew));
+                if (_cxt->size() < _cxt->_concurrent) {
+                    server_worker* wk = _cxt->_workers.size() ? _cxt->pick() : nullptr;
+                    std::shared_ptr<connection_t> con = std::shared_ptr<connection_t>(new connection_t(wk ? wk->_host.get() : &this->_host, fdnew));
                     con->__local = _cxt->_local;
                     con->__peer = from;
                     con->__local.standardize();
-                    _cxt->_connections[fdnew] = con;
-                    
-                    runnable::addListener(this, fdnew);
-                    onConnectionComming(con);
+                    connection_t* raw = con.get();
+                    con->__closed = [this, raw](int fd) {//on the runnable of the connection
+                        mapConnection& conns = _cxt->connections();
+                        mapConnection::iterator it = conns.find(fd);
+                        if (it == conns.end() || it->second.get() != raw) {
+                            return;
+                        }
+                        std::shared_ptr<connection> cnn = std::dynamic_pointer_cast<net::connection>(it->second);
+                        _cxt->erase(it); /*releases its slot of the concurrent limit as well*/
+                        runnable::push(task([this, cnn]() mutable {
+                            onConnectionClose(cnn);
+                        }, this), 0, 1, raw->host(), runnable::LANE_URGENT);
+                    };
+                    if (wk) {//hand over, the connection lives on the worker from now on
+                        wk->_count.fetch_add(1, std::memory_order_relaxed);
+                        runnable::push(task([this, wk, con]() {
+                            wk->_connections[con->id()] = con;
+                            runnable::addListener(this, con->id());
+                            onConnectionComming(con);
+                        }, this), 0, 1, wk->_host.get(), runnable::LANE_URGENT);
+                    }
+                    else {
+                        _cxt->_connections[fdnew] = con;
+                        
+                        runnable::addListener(this, fdnew);
+                        onConnectionComming(con);
+                    }
                 }
                 else {
                     ::close(fdnew);
@@ -473,8 +658,9 @@ namespace net {
             }
         }
         else if (_cxt->_local.proto == net::TCP) {
-            mapConnection::iterator it = _cxt->_connections.find(fd);
-            if (it == _cxt->_connections.end()) {
+            mapConnection& conns = _cxt->connections();
+            mapConnection::iterator it = conns.find(fd);
+            if (it == conns.end()) {
                 log_error("connection[%d] not found!", fd);
                 runnable::removeListener(fd);
                 return;
@@ -489,9 +675,11 @@ namespace net {
             }
             else {
                 log_warning("connection[%d] error!", fd);
+                runnable::removeListener(fd);
                 ::close(fd);
+                it->second->detach();
                 std::shared_ptr<connection> cnn = std::dynamic_pointer_cast<net::connection>(it->second);
-                _cxt->_connections.erase(it);
+                _cxt->erase(it);
                 onConnectionClose(cnn);
             }
         }
@@ -508,20 +696,23 @@ namespace net {
             }
             else {
                 log_warning("connection[%d] error!", fd);
+                runnable::removeListener(fd);
                 ::close(fd);
             }
         }
     }
     
     void    server::onClose(int fd) {
-        mapConnection::iterator it = _cxt->_connections.find(fd);
-        if (it == _cxt->_connections.end()) {//may be close itself
+        mapConnection& conns = _cxt->connections();
+        mapConnection::iterator it = conns.find(fd);
+        if (it == conns.end()) {//may be close itself
             return;
         }
         
         log_warning("connection[%d] closed!", fd);
+        it->second->detach();
         std::shared_ptr<connection> cnn = std::dynamic_pointer_cast<net::connection>(it->second);
-        _cxt->_connections.erase(it);
+        _cxt->erase(it);
         onConnectionClose(cnn);
     }
     
@@ -529,6 +720,144 @@ namespace net {
         return std::shared_ptr<std::string>(new std::string);
     }
     
+    //
+    //______________________________________________________________________
+    struct server_group_cxt {
+        server_group::factory_t _factory;
+        std::vector<std::shared_ptr<runnable>>  _hosts;
+        std::vector<server*>    _servers;   /*touched on its own reactor only*/
+        
+        //stop and join reactors
+        ~server_group_cxt(void) {
+            for (size_t i = 0; i < _hosts.size(); i++) {
+                std::unique_ptr<std::thread> th = _hosts[i]->stop();
+                if (th) th->join();
+            }
+        }
+        
+        //run fn on every reactor, inline for the calling one, and wait for all of them.
+        //return false if any of them failed
+        bool broadcast(std::function<bool(size_t index)> fn) {
+            std::mutex              lock;
+            std::condition_variable cond;
+            size_t                  pending = 0;
+            bool                    failed = false;
+            
+            for (size_t i = 0; i < _hosts.size(); i++) {
+                if (_hosts[i].get() == runnable::current()) {
+                    bool ok = fn(i);
+                    std::lock_guard<std::mutex> _auto_lock(lock);
+                    if (!ok) failed = true;
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> _auto_lock(lock);
+                    pending++;
+                }
+                runnable::task_id id = runnable::push(task([fn, i, &lock, &cond, &pending, &failed]() {
+                    bool ok = fn(i);
+                    std::lock_guard<std::mutex> _auto_lock(lock);
+                    if (!ok) failed = true;
+                    if (--pending == 0) cond.notify_all();
+                }), 0, 1, _hosts[i].get(), runnable::LANE_CONTINUATION);
+                if (id == runnable::invalid_task_id) {//stopped reactor
+                    std::lock_guard<std::mutex> _auto_lock(lock);
+                    failed = true;
+                    pending--;
+                }
+            }
+            std::unique_lock<std::mutex> _auto_lock(lock);
+            while (pending) {
+                cond.wait(_auto_lock);
+            }
+            return !failed;
+        }
+    };
+    
+    server_group::server_group(factory_t factory, size_t count, bool pin) {
+        _cxt = new server_group_cxt();
+        _cxt->_factory = factory;
+        
+        size_t cores = std::thread::hardware_concurrency();
+        if (cores == 0) cores = 1;
+        if (count == 0) count = cores;
+        
+        for (size_t i = 0; i < count; i++) {
+            runnable* ra = new runnable("tsReactor");
+            if (pin) {
+                ra->setPlacement(runnable::placement_t(i % cores));
+            }
+            if (ra->start() == false) {
+                ra->fly();
+                delete _cxt; /*the ones started already*/
+                _cxt = nullptr;
+                throw std::runtime_error("failed to start thread!");
+            }
+            _cxt->_hosts.push_back(std::static_pointer_cast<runnable>(ra->clone()));
+            _cxt->_servers.push_back(nullptr);
+        }
+    }
+    
+    server_group::~server_group(void) {
+        stop();
+        delete _cxt;
+    }
+    
+    bool    server_group::start(const address_t& local) {
+        if (!local.isValid()) {
+            log_error("not valid address, port must be specified for SO_REUSEPORT!");
+            return false;
+        }
+        server_group_cxt* cxt = _cxt;
+        bool ok = cxt->broadcast([cxt, local](size_t index) {
+            if (cxt->_servers[index]) {
+                log_error("illegal call!");
+                return false;
+            }
+            server* s = cxt->_factory(*cxt->_hosts[index]);
+            if (s == nullptr) {
+                return false;
+            }
+            if (s->bind(local, true) == false) {
+                delete s;
+                return false;
+            }
+            cxt->_servers[index] = s;
+            return true;
+        });
+        if (!ok) {
+            log_error("failed to start server group on %s!", local.toString().c_str());
+            stop();
+            return false;
+        }
+        return true;
+    }
+    
+    void    server_group::stop(void) {
+        server_group_cxt* cxt = _cxt;
+        cxt->broadcast([cxt](size_t index) {
+            server* s = cxt->_servers[index];
+            if (s) {
+                s->close();
+                delete s;
+                cxt->_servers[index] = nullptr;
+            }
+            return true;
+        });
+    }
+    
+    size_t  server_group::size(void) const {
+        return _cxt->_hosts.size();
+    }
+    
+    runnable&   server_group::host(size_t index) const {
+        return *_cxt->_hosts[index];
+    }
+    
+    server*     server_group::get(size_t index) const {
+        return _cxt->_servers[index];
+    }
+    
     
     //TCP only connector
     //______________________________________________________________________
@@ -715,6 +1044,7 @@ namespace net {
         }
         else if (tx < 0) {//error occurs
             log_warning("connection[%d] closed!", fd);
+            runnable::removeListener(fd);
             ::close(fd);
             _cxt->_connected = false;
             std::shared_ptr<connection> cnn = std::dynamic_pointer_cast<net::connection>(_cxt->_connection);
@@ -733,6 +1063,7 @@ namespace net {
         }
         else {
             log_warning("connection[%d] timeout!", fd);
+            runnable::removeListener(fd);
             ::close(fd);
             std::shared_ptr<connection> cnn = std::dynamic_pointer_cast<net::connection>(_cxt->_connection);
             onConnectionClose(cnn);
@@ -761,6 +1092,7 @@ namespace net {
             }
             else {
                 log_warning("connection[%d] error!", fd);
+                runnable::removeListener(fd);
                 ::close(fd);
                 _cxt->_connected = false;
                 _cxt->_sock = invalid_sock;
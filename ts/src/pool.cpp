@@ -0,0 +1,436 @@
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <condition_variable>
+#include <ts/pool.h>
+#include <ts/runtime.h>
+#include <ts/log.h>
+
+_TS_NAMESPACE_USING
+_TS_NAMESPACE_BEGIN
+
+void renameThread(const char* name);
+
+//Chase-Lev deque(Le, Pop, Cohen, Nardelli 2013), bottom is touched by the owner only, thieves take from top.
+//capacity is fixed, the owner falls back to the injection queue when it is full
+//_______________________________________________________________________________________________________________
+struct pool_deque {
+    static constexpr int64_t capacity = 1024; /*power of 2*/
+
+    //padded rather than alignas(64), which operator new does not honour before c++17
+    std::atomic<int64_t> _top;
+    char        _pad0[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> _bottom;
+    char        _pad1[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<task*>  _slots[capacity];
+
+    pool_deque(void) : _top(0), _bottom(0) {
+        for (int64_t i = 0; i < capacity; i++) {
+            _slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    //approximately, for stealing hints and stats
+    int64_t size(void) const {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+    //owner only
+    bool push(task* one) {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_acquire);
+        if (b - t >= capacity) {
+            return false;
+        }
+        _slots[b & (capacity - 1)].store(one, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    //owner only, the newest one
+    task* pop(void) {
+        int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = _top.load(std::memory_order_relaxed);
+        if (t > b) {//empty
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        task* one = _slots[b & (capacity - 1)].load(std::memory_order_relaxed);
+        if (t == b) {//the last one, race with thieves
+            if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                one = nullptr;
+            }
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return one;
+    }
+
+    //any thread, the oldest one, return nullptr if empty or lost the race
+    task* steal(void) {
+        int64_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = _bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        task* one = _slots[t & (capacity - 1)].load(std::memory_order_relaxed);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return one;
+    }
+};
+
+struct pool_worker {
+    static constexpr size_t max_spare = 256;
+
+    size_t              index;
+    std::atomic<bool>   alive;
+    std::thread         thread;
+    pool_deque          deque;
+    std::vector<task*>  spare;  /*task shells run by this worker, reused by its own submits, owner only*/
+
+    pool_worker(size_t i) : index(i), alive(false) {}
+    ~pool_worker(void) {
+        for (size_t i = 0; i < spare.size(); i++) {
+            delete spare[i];
+        }
+    }
+};
+
+struct pool_cxt {
+    static constexpr int spins = 64; /*rounds of yield before parking*/
+
+    const char* name;
+    size_t      capacity;   /*slots of workers*/
+    std::atomic<size_t>     minThreads;
+    std::atomic<size_t>     maxThreads;
+    int64_t     keepalive;  /*in miliseconds*/
+    bool        stopping;
+
+    std::vector<std::unique_ptr<pool_worker>> workers;
+
+    std::mutex              lock;
+    std::condition_variable cond;
+    std::deque<task*>       injection;  /*guarded by lock*/
+    std::vector<task*>      spare;      /*guarded by lock, shells spilled by workers for submits from outside*/
+    std::atomic<size_t>     injected;   /*size of injection, for lock-free check*/
+
+    std::atomic<size_t>     threads;
+    std::atomic<size_t>     idle;
+    std::atomic<size_t>     queued;
+    std::atomic<size_t>     peak;
+    std::atomic<uint64_t>   submitted;
+    std::atomic<uint64_t>   executed;
+    std::atomic<uint64_t>   stolen;
+    
+    runnable::placement_t   placement;  /*guarded by lock*/
+    std::atomic<uint64_t>   placed;     /*generation of placement, workers compare with their own*/
+
+    pool_cxt(void) : name(nullptr), capacity(0), minThreads(0), maxThreads(0), keepalive(0), stopping(false), injected(0), threads(0), idle(0), queued(0), peak(0), submitted(0), executed(0), stolen(0), placed(0) {}
+
+    ~pool_cxt(void) {
+        for (size_t i = 0; i < spare.size(); i++) {
+            delete spare[i];
+        }
+    }
+
+    //lock must be held
+    task* shell(task&& ta) {
+        if (spare.empty()) {
+            return new task(std::move(ta));
+        }
+        task* one = spare.back();
+        spare.pop_back();
+        *one = std::move(ta);
+        return one;
+    }
+
+    //called by worker after running one, half of a full cache goes to the shared one
+    void recycle(pool_worker* worker, task* one) {
+        one->reset();
+        if (worker->spare.size() < pool_worker::max_spare) {
+            worker->spare.push_back(one);
+            return;
+        }
+        std::lock_guard<std::mutex> _auto_lock(lock);
+        size_t keep = pool_worker::max_spare / 2;
+        while (worker->spare.size() > keep) {
+            task* p = worker->spare.back();
+            worker->spare.pop_back();
+            if (spare.size() < pool_worker::max_spare * capacity) {
+                spare.push_back(p);
+            }
+            else {
+                delete p;
+            }
+        }
+        worker->spare.push_back(one);
+    }
+
+    bool hasWork(void) const {
+        if (injected.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        for (size_t i = 0; i < capacity; i++) {
+            if (workers[i]->deque.size()) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static thread_local pool_worker*    _local_worker = nullptr;
+static thread_local pool_cxt*       _local_pool = nullptr;
+
+//for pool
+//_______________________________________________________________________________________________________________
+pool::pool(const char* name, size_t minThreads, size_t maxThreads, int64_t keepalive) : _cxt(new pool_cxt()) {
+    if (maxThreads == 0) {
+        maxThreads = std::thread::hardware_concurrency();
+        if (maxThreads == 0) maxThreads = 1;
+    }
+    if (minThreads > maxThreads) {
+        minThreads = maxThreads;
+    }
+    _cxt->name      = name;
+    _cxt->capacity  = maxThreads;
+    _cxt->minThreads= minThreads;
+    _cxt->maxThreads= maxThreads;
+    _cxt->keepalive = keepalive;
+    for (size_t i = 0; i < maxThreads; i++) {
+        _cxt->workers.push_back(std::unique_ptr<pool_worker>(new pool_worker(i)));
+    }
+
+    std::lock_guard<std::mutex> _auto_lock(_cxt->lock);
+    for (size_t i = 0; i < minThreads; i++) {
+        pool_worker* worker = _cxt->workers[i].get();
+        worker->alive = true;
+        _cxt->threads++;
+        worker->thread = std::thread(&pool::work, this, worker);
+    }
+}
+
+pool::~pool(void) {
+    {
+        std::lock_guard<std::mutex> _auto_lock(_cxt->lock);
+        _cxt->stopping = true;
+    }
+    _cxt->cond.notify_all();
+    for (size_t i = 0; i < _cxt->capacity; i++) {
+        pool_worker* worker = _cxt->workers[i].get();
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    //left by racing submits, workers have quit, so run them here
+    for (size_t i = 0; i < _cxt->capacity; i++) {
+        task* one = nullptr;
+        while ((one = _cxt->workers[i]->deque.steal()) != nullptr) {
+            (*one)();
+            delete one;
+        }
+    }
+    while (_cxt->injection.size()) {
+        task* one = _cxt->injection.front();
+        _cxt->injection.pop_front();
+        (*one)();
+        delete one;
+    }
+    delete _cxt;
+}
+
+bool    pool::submit(task&& ta) {
+    if (!ta) {
+        log_warning("illegal argment!");
+        return false;
+    }
+    _cxt->submitted.fetch_add(1, std::memory_order_relaxed);
+    size_t queued = _cxt->queued.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t peak = _cxt->peak.load(std::memory_order_relaxed);
+    while (queued > peak && !_cxt->peak.compare_exchange_weak(peak, queued, std::memory_order_relaxed));
+
+    task* one = nullptr;
+    if (_local_pool == _cxt) {//a worker, shells come from its own cache
+        pool_worker* worker = _local_worker;
+        if (worker->spare.size()) {
+            one = worker->spare.back();
+            worker->spare.pop_back();
+            *one = std::move(ta);
+        }
+        else {
+            one = new task(std::move(ta));
+        }
+        if (!worker->deque.push(one)) {
+            std::lock_guard<std::mutex> _auto_lock(_cxt->lock);
+            _cxt->injection.push_back(one);
+            _cxt->injected.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    else {
+        std::lock_guard<std::mutex> _auto_lock(_cxt->lock);
+        if (_cxt->stopping) {
+            _cxt->queued.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        one = _cxt->shell(std::move(ta));
+        _cxt->injection.push_back(one);
+        _cxt->injected.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //pairs with the idle check of workers before parking
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_cxt->idle.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> _auto_lock(_cxt->lock);
+        _cxt->cond.notify_one();
+    }
+    else if (_cxt->threads.load(std::memory_order_relaxed) < _cxt->maxThreads.load(std::memory_order_relaxed)) {//all busy, one more
+        std::lock_guard<std::mutex> _auto_lock(_cxt->lock);
+        if (!_cxt->stopping && _cxt->threads < _cxt->maxThreads) {
+            for (size_t i = 0; i < _cxt->capacity; i++) {
+                pool_worker* worker = _cxt->workers[i].get();
+                if (worker->alive) {
+                    continue;
+                }
+                if (worker->thread.joinable()) {//quit already
+                    worker->thread.join();
+                }
+                worker->alive = true;
+                _cxt->threads++;
+                worker->thread = std::thread(&pool::work, this, worker);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void    pool::limit(size_t minThreads, size_t maxThreads) {
+    if (maxThreads == 0 || maxThreads > _cxt->capacity) {
+        maxThreads = _cxt->capacity;
+    }
+    if (minThreads > maxThreads) {
+        minThreads = maxThreads;
+    }
+    _cxt->minThreads = minThreads;
+    _cxt->maxThreads = maxThreads;
+}
+
+void    pool::setPlacement(const runnable::placement_t& place) {
+    std::lock_guard<std::mutex> _auto_lock(_cxt->lock);
+    _cxt->placement = place;
+    _cxt->placed.fetch_add(1, std::memory_order_release);
+}
+
+pool::stats_t   pool::stats(void) const {
+    stats_t st;
+    st.threads  = _cxt->threads.load(std::memory_order_relaxed);
+    st.idle     = _cxt->idle.load(std::memory_order_relaxed);
+    st.queued   = _cxt->queued.load(std::memory_order_relaxed);
+    st.peak     = _cxt->peak.load(std::memory_order_relaxed);
+    st.submitted= _cxt->submitted.load(std::memory_order_relaxed);
+    st.executed = _cxt->executed.load(std::memory_order_relaxed);
+    st.stolen   = _cxt->stolen.load(std::memory_order_relaxed);
+    return st;
+}
+
+pool&   pool::shared(void) {
+    static pool* s_pool = new pool("tsBackground"); /*never destroyed, tasks may still be submitted while exiting*/
+    return *s_pool;
+}
+
+void    pool::work(pool_worker* worker) {
+    pool_cxt* cxt = _cxt;
+    _local_worker = worker;
+    _local_pool = cxt;
+    renameThread(cxt->name);
+
+    uint64_t seed = (uint64_t)(worker->index + 1) * 0x9E3779B97F4A7C15ULL;
+    uint64_t placed = 0;
+    int idles = 0;
+    for (;;) {
+        if (placed != cxt->placed.load(std::memory_order_acquire)) {//placement changed
+            runnable::placement_t place;
+            {
+                std::lock_guard<std::mutex> _auto_lock(cxt->lock);
+                placed = cxt->placed.load(std::memory_order_relaxed);
+                place = cxt->placement;
+            }
+            runtime::pin(place);
+        }
+        task* one = worker->deque.pop();
+        if (one == nullptr && cxt->injected.load(std::memory_order_relaxed)) {//shared queue
+            std::lock_guard<std::mutex> _auto_lock(cxt->lock);
+            if (cxt->injection.size()) {
+                one = cxt->injection.front();
+                cxt->injection.pop_front();
+                cxt->injected.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        if (one == nullptr) {//steal from a random victim
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            size_t from = (size_t)(seed % cxt->capacity);
+            for (size_t i = 0; i < cxt->capacity && one == nullptr; i++) {
+                pool_worker* victim = cxt->workers[(from + i) % cxt->capacity].get();
+                if (victim != worker && victim->deque.size()) {
+                    one = victim->deque.steal();
+                }
+            }
+            if (one) {
+                cxt->stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (one) {
+            idles = 0;
+            cxt->queued.fetch_sub(1, std::memory_order_relaxed);
+            (*one)();
+            cxt->recycle(worker, one);
+            cxt->executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (++idles < pool_cxt::spins) {
+            std::this_thread::yield();
+            continue;
+        }
+        idles = 0;
+
+        {//park
+            std::unique_lock<std::mutex> _auto_lock(cxt->lock);
+            if (cxt->stopping) {//quit once nothing is left
+                if (cxt->hasWork()) {
+                    continue;
+                }
+                break;
+            }
+            cxt->idle.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (cxt->hasWork()) {
+                cxt->idle.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            bool timeout = cxt->cond.wait_for(_auto_lock, std::chrono::milliseconds(cxt->keepalive)) == std::cv_status::timeout;
+            cxt->idle.fetch_sub(1, std::memory_order_relaxed);
+            if (cxt->stopping) {//run out the queue first
+                continue;
+            }
+            if (timeout && cxt->threads > cxt->minThreads && !cxt->hasWork()) {//retire
+                cxt->threads--;
+                worker->alive = false;
+                break;
+            }
+        }
+    }
+    _local_worker = nullptr;
+    _local_pool = nullptr;
+}
+
+_TS_NAMESPACE_END
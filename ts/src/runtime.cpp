@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <ts/runtime.h>
+#include <ts/log.h>
+#if defined(_OS_LINUX_)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+_TS_NAMESPACE_USING
+_TS_NAMESPACE_BEGIN
+
+//first line of a sysfs file, empty if not exists
+static std::string readLine(const char* path) {
+    std::string line;
+    FILE* fp = fopen(path, "r");
+    if (fp == nullptr) {
+        return line;
+    }
+    char buf[1024];
+    if (fgets(buf, sizeof(buf), fp)) {
+        line = buf;
+        while (line.size() && (line.back() == '\n' || line.back() == ' ')) {
+            line.pop_back();
+        }
+    }
+    fclose(fp);
+    return line;
+}
+
+//online cores, 0..n-1 if unknown
+static std::vector<size_t> onlineCores(void) {
+    std::vector<size_t> set = runtime::parse(readLine("/sys/devices/system/cpu/online").c_str());
+    if (set.empty()) {
+        for (size_t i = 0; i < runtime::cores(); i++) {
+            set.push_back(i);
+        }
+    }
+    return set;
+}
+
+//numa node of every core, sysfs is read once as topology does not change while running
+static const std::map<size_t, int>& coreNodes(void) {
+    static const std::map<size_t, int> s_nodes = []() {
+        std::map<size_t, int> nodes;
+        std::vector<size_t> set = runtime::parse(readLine("/sys/devices/system/node/online").c_str());
+        for (size_t i = 0; i < set.size(); i++) {
+            std::vector<size_t> cpus = runtime::coresOf((int)set[i]);
+            for (size_t k = 0; k < cpus.size(); k++) {
+                nodes.insert(std::make_pair(cpus[k], (int)set[i]));
+            }
+        }
+        return nodes;
+    }();
+    return s_nodes;
+}
+
+struct runtime_cxt {
+    std::string             name;
+    std::vector<size_t>     cores;  /*core of each runnable*/
+    std::vector<int>        nodes;  /*numa node of each runnable*/
+    std::vector<std::shared_ptr<runnable>>  hosts;
+    std::map<int, std::unique_ptr<pool>>    pools;  /*background pool by numa node*/
+    std::atomic<size_t>     next;
+    
+    runtime_cxt(void) : next(0) {}
+    
+    //stop and join runnables, then run out the pools
+    ~runtime_cxt(void) {
+        for (size_t i = 0; i < hosts.size(); i++) {
+            std::unique_ptr<std::thread> th = hosts[i]->stop();
+            if (th) th->join();
+            hosts[i]->setBackground(nullptr); /*may outlive us*/
+        }
+        hosts.clear();
+        pools.clear(); /*run out queued background tasks*/
+    }
+};
+
+//for runtime
+//_______________________________________________________________________________________________________________
+runtime::runtime(const char* name, const char* cores, bool pin) : _cxt(new runtime_cxt()) {
+    _cxt->name = name ? name : "tsRuntime";
+    if (cores) {
+        _cxt->cores = parse(cores);
+        if (_cxt->cores.empty()) {
+            log_error("illegal cpu list: %s!", cores);
+        }
+    }
+    if (_cxt->cores.empty()) {
+        _cxt->cores = onlineCores();
+    }
+    
+    for (size_t i = 0; i < _cxt->cores.size(); i++) {
+        _cxt->nodes.push_back(node(_cxt->cores[i]));
+    }
+    for (size_t i = 0; i < _cxt->nodes.size(); i++) {
+        int at = _cxt->nodes[i];
+        if (_cxt->pools.find(at) == _cxt->pools.end()) {
+            size_t count = (size_t)std::count(_cxt->nodes.begin(), _cxt->nodes.end(), at);
+            pool* workers = new pool(_cxt->name.c_str(), 0, count);
+            if (pin) {
+                runnable::placement_t place;
+                place.node = at;
+                workers->setPlacement(place);
+            }
+            _cxt->pools[at] = std::unique_ptr<pool>(workers);
+        }
+    }
+    
+    for (size_t i = 0; i < _cxt->cores.size(); i++) {
+        runnable* ra = new runnable(_cxt->name.c_str());
+        if (pin) {
+            ra->setPlacement(runnable::placement_t(_cxt->cores[i]));
+        }
+        ra->setBackground(_cxt->pools[_cxt->nodes[i]].get());
+        if (ra->start() == false) {
+            ra->fly();
+            delete _cxt; /*the ones started already*/
+            _cxt = nullptr;
+            throw std::runtime_error("failed to start thread!");
+        }
+        _cxt->hosts.push_back(std::static_pointer_cast<runnable>(ra->clone()));
+    }
+}
+
+runtime::~runtime(void) {
+    delete _cxt;
+}
+
+const char* runtime::name(void) const {
+    return _cxt->name.c_str();
+}
+
+size_t  runtime::size(void) const {
+    return _cxt->hosts.size();
+}
+
+std::shared_ptr<runnable>   runtime::get(size_t index) const {
+    if (index >= _cxt->hosts.size()) {
+        log_error("illegal argment!");
+        return nullptr;
+    }
+    return _cxt->hosts[index];
+}
+
+std::shared_ptr<runnable>   runtime::next(void) {
+    return _cxt->hosts[_cxt->next.fetch_add(1, std::memory_order_relaxed) % _cxt->hosts.size()];
+}
+
+size_t  runtime::core(size_t index) const {
+    if (index >= _cxt->cores.size()) {
+        log_error("illegal argment!");
+        return 0;
+    }
+    return _cxt->cores[index];
+}
+
+pool&   runtime::background(size_t index) {
+    if (index >= _cxt->nodes.size()) {
+        log_error("illegal argment!");
+        return pool::shared();
+    }
+    return *_cxt->pools[_cxt->nodes[index]];
+}
+
+size_t  runtime::cores(void) {
+    size_t count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+size_t  runtime::nodes(void) {
+    std::vector<size_t> set = parse(readLine("/sys/devices/system/node/online").c_str());
+    return set.empty() ? 1 : set.back() + 1;
+}
+
+int     runtime::node(size_t core) {
+    const std::map<size_t, int>& nodes = coreNodes();
+    std::map<size_t, int>::const_iterator it = nodes.find(core);
+    return it == nodes.end() ? 0 : it->second;
+}
+
+std::vector<size_t> runtime::coresOf(int node) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    std::vector<size_t> set = parse(readLine(path).c_str());
+    if (set.empty() && node == 0) {//not numa
+        set = onlineCores();
+    }
+    return set;
+}
+
+std::vector<size_t> runtime::parse(const char* list) {
+    std::vector<size_t> set;
+    if (list == nullptr) {
+        return set;
+    }
+    const char* p = list;
+    while (*p) {
+        char* end = nullptr;
+        unsigned long from = strtoul(p, &end, 10);
+        if (end == p) {
+            return std::vector<size_t>();
+        }
+        unsigned long to = from;
+        p = end;
+        if (*p == '-') {
+            p++;
+            to = strtoul(p, &end, 10);
+            if (end == p || to < from) {
+                return std::vector<size_t>();
+            }
+            p = end;
+        }
+        for (unsigned long i = from; i <= to; i++) {
+            set.push_back((size_t)i);
+        }
+        if (*p == ',') {
+            p++;
+        }
+        else if (*p) {
+            return std::vector<size_t>();
+        }
+    }
+    std::sort(set.begin(), set.end());
+    set.erase(std::unique(set.begin(), set.end()), set.end());
+    return set;
+}
+
+bool    runtime::pin(const runnable::placement_t& place) {
+#if defined(_OS_LINUX_)
+    std::vector<size_t> set = place.cores;
+    if (set.empty()) {
+        set = place.node >= 0 ? coresOf(place.node) : onlineCores();
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    size_t count = 0;
+    for (size_t i = 0; i < set.size(); i++) {
+        if (set[i] < CPU_SETSIZE) {
+            CPU_SET(set[i], &cpus);
+            count++;
+        }
+    }
+    if (count == 0) {
+        log_warning("illegal argment!");
+        return false;
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        log_warning("failed to pin thread to %d cores!", (int)count);
+        return false;
+    }
+    return true;
+#else
+    (void)place;
+    return false;
+#endif
+}
+
+_TS_NAMESPACE_END
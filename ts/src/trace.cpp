@@ -0,0 +1,292 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <ts/trace.h>
+#include <ts/json.h>
+#include <ts/log.h>
+#if defined(__GNUG__)
+# include <cxxabi.h>
+#endif
+#if defined(_OS_LINUX_)
+# include <pthread.h>
+#endif
+
+_TS_NAMESPACE_USING
+_TS_NAMESPACE_BEGIN
+
+struct trace_record {
+    int64_t     begin;
+    int64_t     end;
+    int64_t     id;
+    const void* scope;
+    const std::type_info* type;
+    const void* owner;
+    int         fd;
+    int         kind;
+};
+
+//a seqlock per slot, seq is 2k+1 while record k is being written and 2k+2 once it is complete.
+//fields are relaxed atomics, a reader racing the writer gets a stale seq and drops the copy
+struct trace_slot {
+    std::atomic<size_t>     seq;
+    std::atomic<int64_t>    begin;
+    std::atomic<int64_t>    end;
+    std::atomic<int64_t>    id;
+    std::atomic<const void*>    scope;
+    std::atomic<const std::type_info*>  type;
+    std::atomic<const void*>    owner;
+    std::atomic<int>        fd;
+    std::atomic<int>        kind;
+    
+    trace_slot(void) : seq(0) {}
+    
+    void store(size_t k, const trace_record& r) {
+        seq.store(2 * k + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        begin.store(r.begin, std::memory_order_relaxed);
+        end.store(r.end, std::memory_order_relaxed);
+        id.store(r.id, std::memory_order_relaxed);
+        scope.store(r.scope, std::memory_order_relaxed);
+        type.store(r.type, std::memory_order_relaxed);
+        owner.store(r.owner, std::memory_order_relaxed);
+        fd.store(r.fd, std::memory_order_relaxed);
+        kind.store(r.kind, std::memory_order_relaxed);
+        seq.store(2 * k + 2, std::memory_order_release);
+    }
+    
+    //false if record k is not there completely, being written or overwritten already
+    bool load(size_t k, trace_record& r) const {
+        size_t before = seq.load(std::memory_order_acquire);
+        if (before != 2 * k + 2) {
+            return false;
+        }
+        r.begin = begin.load(std::memory_order_relaxed);
+        r.end   = end.load(std::memory_order_relaxed);
+        r.id    = id.load(std::memory_order_relaxed);
+        r.scope = scope.load(std::memory_order_relaxed);
+        r.type  = type.load(std::memory_order_relaxed);
+        r.owner = owner.load(std::memory_order_relaxed);
+        r.fd    = fd.load(std::memory_order_relaxed);
+        r.kind  = kind.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq.load(std::memory_order_relaxed) == before;
+    }
+};
+
+//written by its thread only, readers copy it slot by slot
+struct trace_ring {
+    uint64_t    tid;
+    std::string name;
+    std::vector<trace_slot>     records;
+    std::atomic<size_t>         written;
+    
+    trace_ring(size_t capacity) : tid(getThreadId()), records(capacity), written(0) {
+#if defined(_OS_LINUX_)
+        char buf[32] = {0};
+        if (pthread_getname_np(pthread_self(), buf, sizeof(buf)) == 0) {
+            name = buf;
+        }
+#endif
+    }
+};
+
+struct trace_cxt {
+    std::mutex  lock;
+    std::vector<std::shared_ptr<trace_ring>>    rings;  /*kept after their threads quit*/
+    size_t      capacity;
+    std::atomic<uint64_t>   generation; /*bumped by start and clear, rings of old ones are dropped*/
+    
+    trace_cxt(void) : capacity(65536), generation(0) {}
+    
+    static trace_cxt& shared(void) {
+        static trace_cxt* s_trace = new trace_cxt(); /*never destroyed, threads may record while exiting*/
+        return *s_trace;
+    }
+};
+
+static thread_local std::shared_ptr<trace_ring> _local_ring; /*a ring dropped by start or clear lives on until its thread notices*/
+static thread_local uint64_t    _local_generation = 0;
+
+std::atomic<bool>   trace::_enabled(false);
+
+static std::string demangle(const std::type_info* type) {
+    if (type == nullptr) {
+        return "unknown";
+    }
+#if defined(__GNUG__)
+    int status = 0;
+    char* name = abi::__cxa_demangle(type->name(), nullptr, nullptr, &status);
+    if (name) {
+        std::string r(name);
+        free(name);
+        return r;
+    }
+#endif
+    return type->name();
+}
+
+static std::string flowId(const void* scope, int64_t id) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%p:%lld", scope, (long long)id);
+    return buf;
+}
+
+//for trace
+//_______________________________________________________________________________________________________________
+void    trace::start(size_t capacity) {
+    trace_cxt& cxt = trace_cxt::shared();
+    {
+        std::lock_guard<std::mutex> _auto_lock(cxt.lock);
+        cxt.capacity = capacity ? capacity : 1;
+        cxt.rings.clear();
+        cxt.generation++;
+    }
+    _enabled.store(true, std::memory_order_release);
+}
+
+void    trace::stop(void) {
+    _enabled.store(false, std::memory_order_release);
+}
+
+void    trace::clear(void) {
+    trace_cxt& cxt = trace_cxt::shared();
+    std::lock_guard<std::mutex> _auto_lock(cxt.lock);
+    cxt.rings.clear();
+    cxt.generation++;
+}
+
+int64_t trace::now(void) {
+    return getUptimeInNanoseconds();
+}
+
+void    trace::record(event_t kind, const void* scope, int64_t id, int64_t begin, int64_t end, const std::type_info* type, const void* owner, int fd) {
+    trace_cxt& cxt = trace_cxt::shared();
+    if (!_local_ring || _local_generation != cxt.generation.load(std::memory_order_acquire)) {//first event of this thread since start or clear
+        std::lock_guard<std::mutex> _auto_lock(cxt.lock);
+        _local_ring = std::make_shared<trace_ring>(cxt.capacity);
+        cxt.rings.push_back(_local_ring);
+        _local_generation = cxt.generation.load(std::memory_order_relaxed);
+    }
+    trace_ring* ring = _local_ring.get();
+    size_t at = ring->written.load(std::memory_order_relaxed);
+    trace_record r = {begin, end, id, scope, type, owner, fd, kind};
+    ring->records[at % ring->records.size()].store(at, r);
+    ring->written.store(at + 1, std::memory_order_release);
+}
+
+std::string&    trace::dump(std::string& out) {
+    static const char* names[] = {"push", "post", "dequeue", "run", "timer", "recv", "writable", "close"};
+    
+    std::vector<std::shared_ptr<trace_ring>> rings;
+    {
+        trace_cxt& cxt = trace_cxt::shared();
+        std::lock_guard<std::mutex> _auto_lock(cxt.lock);
+        rings = cxt.rings;
+    }
+    int64_t pid = (int64_t)getpid();
+    pie root = std::map<std::string, pie>();
+    root["displayTimeUnit"] = "ns";
+    root["traceEvents"] = std::vector<pie>();
+    std::vector<pie>& events = root["traceEvents"].array();
+    std::set<std::string> linked; /*a repeated timer links its first run only*/
+    
+    for (size_t i = 0; i < rings.size(); i++) {
+        trace_ring* ring = rings[i].get();
+        size_t capacity = ring->records.size();
+        size_t last = ring->written.load(std::memory_order_acquire);
+        size_t first = last > capacity ? last - capacity : 0;
+        std::vector<trace_record> copied;
+        trace_record one;
+        for (size_t k = first; k < last; k++) {
+            if (ring->records[k % capacity].load(k, one)) {
+                copied.push_back(one);
+            }
+        }
+        
+        pie meta = std::map<std::string, pie>();
+        meta["name"] = "thread_name";
+        meta["ph"] = "M";
+        meta["pid"] = pid;
+        meta["tid"] = (int64_t)ring->tid;
+        meta["args"] = std::map<std::string, pie>();
+        meta["args"]["name"] = ring->name.size() ? ring->name : std::string("thread");
+        events.push_back(std::move(meta));
+        
+        for (size_t k = 0; k < copied.size(); k++) {
+            const trace_record& r = copied[k];
+            char owner[32];
+            snprintf(owner, sizeof(owner), "%p", r.owner);
+            
+            pie ev = std::map<std::string, pie>();
+            ev["name"] = demangle(r.type);
+            ev["cat"] = names[r.kind];
+            ev["pid"] = pid;
+            ev["tid"] = (int64_t)ring->tid;
+            ev["ts"] = (double)r.begin / 1000.0; /*in microseconds*/
+            ev["args"] = std::map<std::string, pie>();
+            ev["args"]["owner"] = owner;
+            if (r.fd >= 0) {
+                ev["args"]["fd"] = r.fd;
+            }
+            if (r.kind >= EVENT_RUN) {
+                ev["ph"] = "X";
+                ev["dur"] = (double)(r.end - r.begin) / 1000.0;
+            }
+            else {
+                ev["ph"] = "i";
+                ev["s"] = "t";
+            }
+            ev["args"]["id"] = r.id;
+            events.push_back(std::move(ev));
+            
+            if (r.kind == EVENT_PUSH || r.kind == EVENT_POST || r.kind == EVENT_RUN || r.kind == EVENT_TIMER) {//flow from push to run
+                std::string id = flowId(r.scope, r.id);
+                if ((r.kind == EVENT_RUN || r.kind == EVENT_TIMER) && !linked.insert(id).second) {
+                    continue;
+                }
+                pie flow = std::map<std::string, pie>();
+                flow["name"] = "queue";
+                flow["cat"] = "flow";
+                flow["id"] = id;
+                flow["pid"] = pid;
+                flow["tid"] = (int64_t)ring->tid;
+                flow["ts"] = (double)r.begin / 1000.0;
+                if (r.kind == EVENT_PUSH || r.kind == EVENT_POST) {
+                    flow["ph"] = "s";
+                }
+                else {
+                    flow["ph"] = "f";
+                    flow["bp"] = "e";
+                }
+                events.push_back(std::move(flow));
+            }
+        }
+    }
+    return json::format(root, out, true);
+}
+
+long    trace::toFile(const char* file) {
+    if (file == nullptr) {
+        log_error("illegal argment!");
+        return -1;
+    }
+    std::string out;
+    dump(out);
+    FILE* fp = fopen(file, "wb");
+    if (fp == nullptr) {
+        log_error("failed to open %s!", file);
+        return -1;
+    }
+    size_t n = fwrite(out.c_str(), 1, out.size(), fp);
+    fclose(fp);
+    return (long)n;
+}
+
+_TS_NAMESPACE_END
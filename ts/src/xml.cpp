@@ -6,6 +6,7 @@
 #include <ts/xml.h>
 #include <ts/string.h>
 #include <ts/log.h>
+#include <ts/file.h>
 
 _TS_NAMESPACE_USING
 
@@ -458,6 +459,13 @@ namespace xml {
         return parse(out, szb.get(), err, tags_excluding);
     }
     
+    void            fromFileAsync(const char* file, loaded_t cb, const char* tags_excluding) {
+        std::string tags(tags_excluding ? tags_excluding : "");
+        ts::file::loadFile(file, [tags](const char* data, ts::pie& out, std::string& err) {
+            return parse(out, data, err, tags.c_str());
+        }, cb);
+    }
+    
     long            toFile(const ts::pie& js, const char* file) {
         std::string s;
         format(js, s);
@@ -0,0 +1,75 @@
+//steady-state tasks must not touch the global allocator: action nodes come from the free list of the runnable.
+//run from the ts directory: make test, exits non-zero on failure
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <ts/asyn.h>
+
+_TS_NAMESPACE_USING
+
+static std::atomic<uint64_t> _mallocs(0);
+
+void* operator new(size_t size) {
+    _mallocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+//kept out of line, gcc pairs an inlined free with the new expression and warns
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+struct chain {
+    static constexpr int warmup = 10000;
+    static constexpr int steady = 1000000;
+
+    int         count;
+    uint64_t    mallocs;    //global allocations when the steady phase begins
+    runnable::stats_t   stats;
+    std::atomic<bool>   done;
+
+    chain(void) : count(0), mallocs(0), done(false) {}
+
+    void step(void) {
+        count++;
+        if (count == warmup) {
+            stats = runnable::current()->stats();
+            mallocs = _mallocs.load(std::memory_order_relaxed);
+        }
+        else if (count == warmup + steady) {
+            done = true;
+            return;
+        }
+        runnable::push(task([this]() {
+            step();
+        }));
+    }
+};
+
+int main(int argc, char* argv[]) {
+    runnable* loop = new runnable("alloc");
+    loop->start();
+    chain* ch = new chain();
+    runnable::push(task([ch]() {
+        ch->step();
+    }), 0, 1, loop);
+    while (!ch->done) {
+        usleep(1000);
+    }
+    uint64_t mallocs = _mallocs.load(std::memory_order_relaxed) - ch->mallocs;
+    runnable::stats_t st = loop->stats();
+    uint64_t nodes = st.allocated - ch->stats.allocated;
+    printf("tasks=%d mallocs=%llu nodes allocated=%llu recycled=%llu\n", chain::steady, (unsigned long long)mallocs, (unsigned long long)nodes, (unsigned long long)(st.recycled - ch->stats.recycled));
+    fflush(stdout);
+    _exit(mallocs == 0 && nodes == 0 ? 0 : 1);
+}
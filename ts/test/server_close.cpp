@@ -0,0 +1,95 @@
+//connections closed by the server itself must be dropped and reported, or the concurrent limit fills up and refuses everyone.
+//run from the ts directory: make test, exits non-zero on failure
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <vector>
+#include <ts/net.h>
+#include <ts/log.h>
+
+_TS_NAMESPACE_USING
+
+struct closer : public net::server {
+    std::atomic<int>    closed;
+
+    closer(runnable const& host, uint16_t concurrent) : net::server(host, concurrent), closed(0) {}
+
+    //echo once, then close from the server side
+    void onConnectionRecv(std::shared_ptr<net::connection>&& conn, const net::address_t& from, std::shared_ptr<std::string>& packet) {
+        conn->send(packet);
+        conn->close();
+    }
+    void onConnectionClose(std::shared_ptr<net::connection>& conn) {
+        closed.fetch_add(1);
+    }
+    void onConnectionComming(std::shared_ptr<net::connection>&& conn) {}
+};
+
+//true if the server echoed and then closed
+static bool dial(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    struct timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    bool ok = false;
+    char buf[8];
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0 && send(fd, "x", 1, MSG_NOSIGNAL) == 1) {
+        ok = recv(fd, buf, sizeof(buf), 0) == 1 && buf[0] == 'x' && recv(fd, buf, sizeof(buf), 0) == 0;
+    }
+    close(fd);
+    return ok;
+}
+
+static bool round(runnable* host, const std::vector<std::shared_ptr<runnable>>& workers, uint16_t port) {
+    const uint16_t concurrent = 2;
+    const int count = 4 * concurrent + 1;    //the last one must still be accepted
+
+    closer* svr = new closer(*host, concurrent);
+    svr->setWorkers(workers);
+    std::atomic<int> bound(-1);
+    runnable::push(task([svr, port, &bound]() {
+        bound = svr->bind(net::address_t("127.0.0.1", port)) ? 1 : 0;
+    }), 0, 1, host);
+    while (bound < 0) {
+        usleep(1000);
+    }
+
+    int accepted = 0;
+    for (int i = 0; bound && i < count; i++) {
+        if (dial(port)) {
+            accepted++;
+        }
+    }
+    for (int i = 0; i < 2000 && svr->closed < accepted; i++) {
+        usleep(1000);
+    }
+    printf("workers=%d accepted=%d/%d closed=%d\n", (int)workers.size(), accepted, count, svr->closed.load());
+    bool ok = accepted == count && svr->closed == count;
+    delete svr;
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    setvbuf(stdout, NULL, _IONBF, 0);
+    log::hook([](log::level, int, const char*, const char*, int, const char*, int) {});
+
+    runnable* host = new runnable("acceptor");
+    host->start();
+    std::vector<std::shared_ptr<runnable>> workers;
+    bool ok = round(host, workers, 17950);
+    for (int i = 0; i < 2; i++) {
+        runnable* wk = new runnable("worker");
+        wk->start();
+        workers.push_back(std::static_pointer_cast<runnable>(wk->clone()));
+    }
+    ok = round(host, workers, 17951) && ok;
+    _exit(ok ? 0 : 1);
+}